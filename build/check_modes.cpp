@@ -0,0 +1,104 @@
+//compares modes of the experimental native modal backend with those of CAMBALA for a layered medium with density jumps,
+//exits with a non-zero code if they differ by more than the tolerances below; it is not a part of the default build
+//and has to be linked against the full CAMBALA library, run it with cmake --build . --target check_modes && ./check_modes
+
+#include <cmath>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include "modal_problem.hpp"
+#include "utils/types.hpp"
+#include "utils/utils.hpp"
+
+using namespace ample;
+using real_t = types::real_t;
+
+//relative to the largest value compared, these are the wanted agreement rather than an observed one
+constexpr auto k_tolerance = real_t(1e-8);
+constexpr auto phi_tolerance = real_t(1e-5);
+constexpr auto attenuation_tolerance = real_t(1e-6);
+
+//water of three layers over a sediment and a basement, every one with a different density, so the mesh has
+//interfaces with and without density jumps; sound speed in water is shifted by dc
+NormalModes layered(const real_t& dc) {
+    NormalModes n_m;
+    n_m.iModesSubset = -1;
+    n_m.ppm = 2;
+    n_m.ordRich = 3;
+    n_m.f = 100;
+    n_m.nmod = 0;
+    n_m.alpha = 0;
+    n_m.M_depths = { 30, 60, 100, 120, 300 };
+    n_m.M_c1s = { 1500 + dc, 1495 + dc, 1490 + dc, 1650, 1900 };
+    n_m.M_c2s = { 1495 + dc, 1490 + dc, 1485 + dc, 1700, 1950 };
+    n_m.M_rhos = { 1, 1, 1, 1.5, 2 };
+    n_m.M_betas = { 0, 0, 0, 0.5, 0.8 };
+    n_m.M_Ns_points.resize(n_m.M_depths.size());
+    for (size_t i = 0; i < n_m.M_depths.size(); ++i)
+        n_m.M_Ns_points[i] = static_cast<unsigned>(std::round(n_m.ppm * (n_m.M_depths[i] - (i ? n_m.M_depths[i - 1] : 0))));
+    const auto z = utils::mesh_1d(real_t(0), real_t(100), 201);
+    n_m.zr.assign(z.begin(), z.end());
+    return n_m;
+}
+
+void cold(NormalModes& n_m) {
+    n_m.eigen_type = "alglib";
+    n_m.compute_khs();
+    n_m.compute_mfunctions_zr();
+    n_m.compute_mattenuation();
+}
+
+//prints the largest relative differences of wavenumbers, attenuation and modal functions up to their sign
+bool compare(const std::string& name, const NormalModes& a, const NormalModes& b) {
+    if (a.khs.size() != b.khs.size() || a.khs.empty()) {
+        std::cout << name << ": " << a.khs.size() << " modes against " << b.khs.size() << std::endl;
+        return false;
+    }
+
+    auto dk = real_t(0), mk = real_t(0), da = real_t(0), ma = real_t(0), dp = real_t(0), mp = real_t(0);
+    for (size_t j = 0; j < a.khs.size(); ++j) {
+        dk = std::max(dk, std::abs(a.khs[j] - b.khs[j]));
+        mk = std::max(mk, std::abs(b.khs[j]));
+        da = std::max(da, std::abs(a.mattenuation[j] - b.mattenuation[j]));
+        ma = std::max(ma, std::abs(b.mattenuation[j]));
+
+        auto plus = real_t(0), minus = real_t(0);
+        for (size_t i = 0; i < a.mfunctions_zr[j].size(); ++i) {
+            plus = std::max(plus, std::abs(a.mfunctions_zr[j][i] + b.mfunctions_zr[j][i]));
+            minus = std::max(minus, std::abs(a.mfunctions_zr[j][i] - b.mfunctions_zr[j][i]));
+            mp = std::max(mp, std::abs(b.mfunctions_zr[j][i]));
+        }
+        dp = std::max(dp, std::min(plus, minus));
+    }
+
+    const auto passed = dk <= k_tolerance * mk && da <= attenuation_tolerance * ma && dp <= phi_tolerance * mp;
+    std::cout << name << ": " << a.khs.size() << " modes, k " << dk / mk << ", attenuation " << da / ma << ", phi " << dp / mp
+              << (passed ? "" : " FAILED") << std::endl;
+    return passed;
+}
+
+int main() {
+    auto reference = layered(0);
+    cold(reference);
+
+    //native backend is meant to replace alglib one, so it is expected to yield the same modes
+    auto native = layered(0);
+    native.eigen_type = "native";
+    solve_modes<real_t>(native, true);
+    auto passed = compare("native against alglib", native, reference);
+
+    auto shifted = layered(real_t(0.5));
+    cold(shifted);
+
+    //continuation starts from wavenumbers of the unshifted medium, as it does from a neighbouring point
+    auto continued = layered(real_t(0.5));
+    continued.eigen_type = "native";
+    if (!continue_modes<real_t>(continued, reference.khs, true)) {
+        std::cout << "continuation could not refine the guesses FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    passed = compare("continued against alglib", continued, shifted) && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,29 +4,37 @@
 
 #include <set>
 #include <cmath>
+#include <deque>
+#include <mutex>
 #include <tuple>
 #include <chrono>
 #include <string>
+#include <thread>
 #include <complex>
 #include <cstring>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <numeric>
+#include <optional>
 #include <iomanip>
 #include <iostream>
 #include <algorithm>
 #include <filesystem>
 #include <functional>
 #include <unordered_set>
+#include <condition_variable>
 #include "rays.hpp"
 #include "config.hpp"
+#include "mode_tensor.hpp"
 #include "solver.hpp"
+#include "modes_stream.hpp"
 #include "io/writer.hpp"
 #include "utils/fft.hpp"
 #include "feniks/zip.hpp"
 #include "utils/types.hpp"
 #include "utils/utils.hpp"
+#include "utils/tensor.hpp"
 #include "nlohmann/json.hpp"
 #include "utils/callback.hpp"
 #include "utils/verbosity.hpp"
@@ -537,21 +545,36 @@ void write_modes(const ample::utils::linear_interpolated_data_1d<types::real_t,
         writer(modes[i].data());
 }
 
-template<typename V, typename W>
-void write_modes(const ample::utils::linear_interpolated_data_2d<types::real_t, V>& modes, W&& writer) {
+template<typename V, typename D, typename W>
+void write_modes(const ample::utils::linear_interpolated_data_2d<types::real_t, V, D>& modes, W&& writer) {
     for (size_t i = 0; i < modes.size(); ++i)
         for (const auto& it : modes[i].data())
             writer(it);
 }
 
-template<typename V, typename W>
-void write_modes(const ample::utils::linear_interpolated_data_3d<types::real_t, V>& modes, W&& writer) {
+template<typename V, typename D, typename W>
+void write_modes(const ample::utils::linear_interpolated_data_3d<types::real_t, V, D>& modes, W&& writer) {
     for (size_t i = 0; i < modes.size(); ++i)
         for (const auto& field : modes[i].data())
             for (const auto& row : field)
                 writer(row);
 }
 
+std::string mode_tensor_name() {
+    return helper.to_string(config.f()) + ".modes";
+}
+
+//x-dependent modes are also stored as a mode tensor, which later runs map instead of computing modes
+template<typename V, typename KD, typename PD>
+void write_mode_tensor(const std::filesystem::path& path,
+                       const ample::utils::linear_interpolated_data_2d<types::real_t, V, KD>& k_j,
+                       const ample::utils::linear_interpolated_data_3d<types::real_t, types::real_t, PD>& phi_j) {
+    ample::mode_tensor<types::real_t, V>::create(path, k_j.template get<0>(), k_j.template get<1>(), phi_j.template get<2>(), k_j.size()).assign(k_j, phi_j);
+}
+
+template<typename K, typename P>
+void write_mode_tensor(const std::filesystem::path&, const K&, const P&) {}
+
 template<typename V, typename W>
 void write_strided(const V& v, const size_t& k, W&& writer) {
     auto [begin, end] = ample::utils::stride(v.begin(), v.end(), k);
@@ -592,18 +615,39 @@ template<typename S, typename K, typename V, typename I, typename C>
 void solve(S& solver, const I& init, const K& k0,
            const ample::utils::linear_interpolated_data_1d<types::real_t, V>& k_j,
            const ample::utils::linear_interpolated_data_2d<types::real_t>& phi_j,
-           C&& callback, const size_t& num_workers, const size_t& buff_size) {
-    solver.solve(init, k0, k_j, phi_j, callback, num_workers, buff_size);
+           C&& callback, const ample::utils::output_schedule& schedule, const size_t& num_workers, const size_t& buff_size) {
+    solver.solve(init, k0, k_j, phi_j, callback, schedule, num_workers, buff_size);
 }
 
-template<typename S, typename K, typename V, typename I, typename C>
+template<typename S, typename K, typename V, typename KD, typename PD, typename I, typename C>
 void solve(S& solver, const I& init, const K& k0,
-           const ample::utils::linear_interpolated_data_2d<types::real_t, V>& k_j,
-           const ample::utils::linear_interpolated_data_3d<types::real_t>& phi_j,
-           C&& callback, const size_t& num_workers, const size_t& buff_size) {
-    solver.solve(init, k0, k_j, phi_j, callback, num_workers, buff_size);
+           const ample::utils::linear_interpolated_data_2d<types::real_t, V, KD>& k_j,
+           const ample::utils::linear_interpolated_data_3d<types::real_t, types::real_t, PD>& phi_j,
+           C&& callback, const ample::utils::output_schedule& schedule, const size_t& num_workers, const size_t& buff_size) {
+    solver.solve(init, k0, k_j, phi_j, callback, schedule, num_workers, buff_size);
+}
+
+//modes of the field that are computed slab by slab while the solution marches, see ample::modes_stream
+template<typename V>
+struct streamed_modes {
+
+    size_t nm, num_workers;
+
+};
+
+template<typename S, typename K, typename V, typename I, typename C>
+void solve(S& solver, const I& init, const K& k0, const streamed_modes<V>& k_j, const streamed_modes<V>&,
+           C&& callback, const ample::utils::output_schedule& schedule, const size_t& num_workers, const size_t& buff_size) {
+    const ample::modes_stream<types::real_t, V> modes(config, k_j.nm, config.modes_slab(), k_j.num_workers);
+    solver.solve(init, k0, modes, callback, schedule, num_workers, buff_size);
 }
 
+const std::set<std::string> available_precisions {
+    "double",
+    "single",
+    "validate"
+};
+
 const std::set<std::string> available_jobs {
     "sel",
     "init",
@@ -650,6 +694,7 @@ public:
 
     ::jobs jobs;
     bool binary;
+    std::string precision;
     size_t row_step, col_step, num_workers, buff_size;
     std::filesystem::path output, config_path;
 
@@ -668,6 +713,7 @@ public:
         _prep("rays", field_group::rays, group);
         _prep("modes", "phi_j", field_group::modes, group);
         _prep("modes", "k_j", field_group::modes, group);
+        _prep("modes", field_group::modes, group);
         _prep("solution", field_group::modes | field_group::solver | field_group::initial, group);
 
         if (jobs.has_job("impulse"))
@@ -861,20 +907,95 @@ private:
     template<template<typename> typename W, bool Const>
     void _pick_complex() {
         if (config.complex_modes())
-            performer<W, make_modes<Const, types::complex_t>>(*this).perform();
+            _pick_stream<W, Const, types::complex_t>();
         else
-            performer<W, make_modes<Const, types::real_t>>(*this).perform();
+            _pick_stream<W, Const, types::real_t>();
 
     }
 
+    template<template<typename> typename W, bool Const, typename T>
+    void _pick_stream() {
+        if (!Const && !config.mode_tensors().empty() && jobs.has_job("modes"))
+            throw std::logic_error("Mapped modes can not be used with modes job");
+
+        //modes given as input are used as they are loaded, unless mapped ones take precedence
+        if (!Const && config.mode_tensors().empty() && config.has_modes<T>()) {
+            performer<W, input_modes<T>>(*this).perform();
+            return;
+        }
+
+        if (Const || !config.modes_slab() || !config.mode_tensors().empty()) {
+            performer<W, make_modes<Const, T>>(*this).perform();
+            return;
+        }
+
+        if (jobs.has_job("modes") || jobs.has_job("rays"))
+            throw std::logic_error("Streamed modes can not be used with modes and rays jobs");
+        performer<W, stream_modes<T>>(*this).perform();
+    }
+
+    //modes are kept between frequencies, so the environment is sampled once and frequencies continue each other
     template<bool Const, typename T>
     struct make_modes {
 
-        static auto make(const size_t& nw, const size_t& nm, const bool& show_progress) {
+        static constexpr auto streamed = false;
+
+        auto make(const size_t& nw, const size_t& nm, const bool& show_progress) {
             if constexpr (Const)
-                return config.create_const_modes<T>(nw, nm, show_progress);
-            else
-                return config.create_modes<T>(nw, nm, show_progress);
+                return config.create_const_modes<T>(_get_modes(), nw, nm, show_progress);
+            else {
+                if (config.mode_tensors().empty())
+                    return config.create_modes<T>(_get_modes(), nw, nm, show_progress);
+
+                const auto modes = ample::mode_tensor<types::real_t, T>::map(std::filesystem::path(config.mode_tensors()) / mode_tensor_name());
+                ample::utils::dynamic_assert(modes.size() >= nm,
+                    "Insufficient number of mapped modes. Expected no less than ", nm, ", but got ", modes.size());
+                return modes.interpolated();
+            }
+        }
+
+        static auto make_source() {
+            return config.create_source_modes<T>(config.n_modes());
+        }
+
+    private:
+
+        std::optional<ample::modes<types::real_t, T>> _modes;
+
+        auto& _get_modes() {
+            if (!_modes.has_value())
+                _modes.emplace(config, ample::utils::mesh_1d(config.z0(), config.z1(), config.mnz()));
+            return *_modes;
+        }
+
+    };
+
+    //modes given as input data keep their own meshes, nothing is computed or resampled
+    template<typename T>
+    struct input_modes {
+
+        static constexpr auto streamed = false;
+
+        static auto make(const size_t&, const size_t& nm, const bool&) {
+            return config.input_modes<T>(nm);
+        }
+
+        static auto make_source() {
+            return config.create_source_modes<T>(config.n_modes());
+        }
+
+    };
+
+    //modes are only described here and computed by the solver, see solve for streamed_modes
+    template<typename T>
+    struct stream_modes {
+
+        static constexpr auto streamed = true;
+
+        //the producer works alongside marching workers, so it is given its own number of workers
+        static auto make(const size_t&, const size_t& nm, const bool&) {
+            const auto nw = std::max(size_t(1), config.modes_slab_workers());
+            return std::make_tuple(streamed_modes<T>{ nm, nw }, streamed_modes<T>{ nm, nw });
         }
 
         static auto make_source() {
@@ -888,6 +1009,8 @@ private:
 
     public:
 
+        static constexpr size_t validate_fields = 4;
+
         performer(jobs_config& owner) : _owner(owner) {}
 
         void perform() {
@@ -937,6 +1060,13 @@ private:
                 );
             }
 
+            const ample::utils::output_schedule rows(_owner.row_step);
+            if (has_impulse)
+                _schedule = has_sel || _owner.jobs.has_job("solution") ?
+                    ample::utils::merge(rows, _impulse_schedule(), config.nx()) : _impulse_schedule();
+            else
+                _schedule = rows;
+
             const auto [f0, f1] = config.sel_range();
             ample::utils::progress_bar pbar(config.frequencies().size(), "Frequency", verbose(2), ample::utils::progress_bar::on_end::leave);
 
@@ -1043,6 +1173,7 @@ private:
 
     private:
 
+        M _maker;
         types::real_t _max;
         jobs_config& _owner;
         types::complex_t _s;
@@ -1053,6 +1184,7 @@ private:
         ample::utils::real_fft<types::real_t, types::complex_t>* _fft = nullptr;
         types::vector2d_t<types::complex_t>* _impulse_result = nullptr;
         types::vector3d_t<types::complex_t>* _sel_buffer = nullptr;
+        ample::utils::output_schedule _schedule;
 
         void _load_source_spectrum() {
             ample::utils::dynamic_assert(!(config.has_source_function() && config.has_source_spectrum()),
@@ -1091,6 +1223,21 @@ private:
             ));
         }
 
+        //impulse needs rows right before and after each receiver, see _perform_impulse
+        [[nodiscard]] ample::utils::output_schedule _impulse_schedule() const {
+            const auto nx = config.nx();
+            const auto hx = (config.x1() - config.x0()) / (nx - 1);
+
+            types::vector1d_t<size_t> steps;
+            for (const auto& it : config.receivers()) {
+                const auto i = static_cast<size_t>(std::max(types::real_t(1), std::ceil((it.x - 2 * config.x0()) / hx)));
+                for (size_t j = i > 2 ? i - 2 : 0; j <= i + 1 && j < nx; ++j)
+                    steps.push_back(j);
+            }
+
+            return ample::utils::output_schedule(std::move(steps));
+        }
+
         template<typename K0, typename P0, typename KJ>
         auto _perform_init(const K0& k0, const P0& phi_s, const KJ& k_j) {
             const auto init = get_initial_conditions(k0, phi_s, k_j);
@@ -1107,23 +1254,27 @@ private:
             _owner._n_modes.push_back(nm);
 
             const auto start = std::chrono::system_clock::now();
-            auto [k_j, phi_j] = M::make(_owner.num_workers, nm, verbose(2));
+            auto [k_j, phi_j] = _maker.make(_owner.num_workers, nm, verbose(2));
             const auto end = std::chrono::system_clock::now();
             verboseln_lv(1, "Modes computing time: ", std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), "ms");
 
-            if (k_j.size() > nm) {
-                k_j.erase_last(k_j.size() - nm);
-                phi_j.erase_last(phi_j.size() - nm);
-            }
+            //streamed modes are computed during the solution, there is nothing to trim or write yet
+            if constexpr (!M::streamed) {
+                if (k_j.size() > nm) {
+                    k_j.erase_last(k_j.size() - nm);
+                    phi_j.erase_last(phi_j.size() - nm);
+                }
 
-            if (_owner.jobs.has_job("modes")) {
-                write_modes(k_j,
-                    [writer=W<types::real_t>(_owner._get_filename("k_j"))](const auto &data) mutable {
-                        writer.write(reinterpret_cast<const types::real_t*>(data.data()),\
-                        data.size() * sizeof(data[0]) / sizeof(types::real_t)
-                    );
-                });
-                write_modes(phi_j, W<types::real_t>(_owner._get_filename("phi_j")));
+                if (_owner.jobs.has_job("modes")) {
+                    write_modes(k_j,
+                        [writer=W<types::real_t>(_owner._get_filename("k_j"))](const auto &data) mutable {
+                            writer.write(reinterpret_cast<const types::real_t*>(data.data()),\
+                            data.size() * sizeof(data[0]) / sizeof(types::real_t)
+                        );
+                    });
+                    write_modes(phi_j, W<types::real_t>(_owner._get_filename("phi_j")));
+                    write_mode_tensor(_owner.output / "modes" / mode_tensor_name(), k_j, phi_j);
+                }
             }
 
             if constexpr (std::is_same_v<decltype(k0[0]), decltype(phi_s[0])>)
@@ -1144,29 +1295,31 @@ private:
 
         template<typename KJ, typename PJ>
         void _perform_rays(const KJ& k_j, const PJ& phi_j) {
-            if (_owner.jobs.has_job("rays")) {
-                const auto na = config.na();
-                const auto nl = config.nl();
-                const auto nm = k_j.size();
+            if constexpr (!M::streamed)
+                if (_owner.jobs.has_job("rays")) {
+                    const auto na = config.na();
+                    const auto nl = config.nl();
+                    const auto nm = k_j.size();
 
-                const auto [rx, ry] = ample::rays::compute(
-                    config.x0(), config.y_s(), config.l1(), nl, config.a0(), config.a1(), na, k_j, verbose(2));
+                    const auto [rx, ry] = ample::rays::compute(
+                        config.x0(), config.y_s(), config.l1(), nl, config.a0(), config.a1(), na, k_j, verbose(2));
 
-                write_rays(rx, ry, nm, _owner.row_step, _owner.col_step, ample::utils::binary_writer<types::real_t>(_owner._get_filename("rays")));
-            }
+                    write_rays(rx, ry, nm, _owner.row_step, _owner.col_step, ample::utils::binary_writer<types::real_t>(_owner._get_filename("rays")));
+                }
         }
 
         template<typename I, typename K0, typename KJ, typename PJ>
         void _perform_sel(const I& init, const K0& k0, const KJ& k_j, const PJ& phi_j) {
             if (_owner.jobs.has_job("sel"))
                 _perform_impulse(init, k0, k_j, phi_j,
-                    ample::utils::ekc_callback(_owner.row_step,
+                    ample::utils::schedule_callback(ample::utils::output_schedule(_owner.row_step), _schedule, config.nx(),
                         [&sel_buffer=*_sel_buffer, i=size_t(0), this](const auto& x, const auto& data) mutable {
                             size_t j = 0;
 
                             auto [begin, end] = ample::utils::stride(data.begin(), data.end(), _owner.col_step);
                             while (begin != end) {
-                                sel_buffer[i][j++] = *begin;
+                                const auto row = *begin;
+                                sel_buffer[i][j++].assign(row.begin(), row.end());
                                 ++begin;
                             }
 
@@ -1190,7 +1343,7 @@ private:
                         &iz=*_iz,
                         &fi=config.index(),
                         &s=_s,
-                        last=types::vector2d_t<types::complex_t>(),
+                        last=ample::utils::tensor<types::complex_t, 2>(),
                         last_x=config.x0(),
                         li=0,
                         ir=config.reference_index()
@@ -1213,7 +1366,7 @@ private:
                             }
                         }
                         last_x = x;
-                        last.assign(data.begin(), data.end());
+                        last.assign(data);
                     }
                 );
             else 
@@ -1225,7 +1378,7 @@ private:
             if (_owner.jobs.has_job("solution")) {
                 W<types::real_t> writer(_owner._get_filename("solution"));
                 _perform_solve(init, k0, k_j, phi_j, std::forward<C>(callbacks)...,
-                    ample::utils::ekc_callback(_owner.row_step,
+                    ample::utils::schedule_callback(ample::utils::output_schedule(_owner.row_step), _schedule, config.nx(),
                         [&writer, this](const auto& x, const auto& data) mutable {
                             for (size_t i = 0; i < data.size(); i += _owner.col_step)
                                 writer.write(reinterpret_cast<const types::real_t*>(data[i].data()), data[i].size() * 2);
@@ -1243,24 +1396,115 @@ private:
                 return;
 
             const auto descriptor = config.boundary_conditions();
-
-            ample::solver solver(
-                descriptor.construct<
-                    ample::pml_boundary_conditions<types::real_t>, size_t, ample::pml_function<types::real_t>>("width" ,"function"),
-                config
-            );
+            const auto boundary_conditions = descriptor.construct<
+                ample::pml_boundary_conditions<types::real_t>, size_t, ample::pml_function<types::real_t>>("width" ,"function");
 
             auto callback = ample::utils::callbacks(
-                ample::utils::progress_bar_callback(config.nx(), "Solution", verbose(2)),
+                ample::utils::progress_bar_callback(_schedule.count(config.nx()), "Solution", verbose(2)),
                 std::forward<C>(callbacks)...
             );
 
             const auto start = std::chrono::system_clock::now();
-            solve(solver, init, k0, k_j, phi_j, callback, _owner.num_workers, _owner.buff_size);
+            if (_owner.precision == "single")
+                _solve<types::single_complex_t>(boundary_conditions, init, k0, k_j, phi_j,
+                    ample::utils::convert_callback<types::complex_t>(callback));
+            else if (_owner.precision == "validate")
+                _validate(boundary_conditions, init, k0, k_j, phi_j, callback);
+            else
+                _solve<types::complex_t>(boundary_conditions, init, k0, k_j, phi_j, callback);
             const auto end = std::chrono::system_clock::now();
             verboseln_lv(1, "Elapsed time: ", std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count(), "ms");
         }
 
+        //V is the type modal amplitudes are marched in, coefficients and bands are always computed in double
+        template<typename V, typename B, typename I, typename K0, typename KJ, typename PJ, typename C>
+        void _solve(const B& boundary_conditions, const I& init, const K0& k0, const KJ& k_j, const PJ& phi_j, C&& callback) {
+            ample::solver<B, types::real_t, types::complex_t, V> solver(boundary_conditions, config);
+            solve(solver, init, k0, k_j, phi_j, callback, _schedule, _owner.num_workers, _owner.buff_size);
+        }
+
+        //the single precision run marches on a thread of its own alongside the double run that is passed to callback,
+        //its fields wait to be compared in a queue of at most validate_fields ones, so memory does not grow with nx
+        template<typename B, typename I, typename K0, typename KJ, typename PJ, typename C>
+        void _validate(const B& boundary_conditions, const I& init, const K0& k0, const KJ& k_j, const PJ& phi_j, C& callback) {
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::deque<ample::utils::tensor<types::single_complex_t, 2>> fields;
+            bool done = false, stop = false;
+            std::exception_ptr error;
+
+            //solver callbacks must not throw, so a run that has to end early only stops passing fields
+            std::thread single([&]() {
+                try {
+                    _solve<types::single_complex_t>(boundary_conditions, init, k0, k_j, phi_j,
+                        [&](const auto&, const auto& data) {
+                            ample::utils::tensor<types::single_complex_t, 2> field(data);
+                            {
+                                std::unique_lock<std::mutex> lock(mutex);
+                                changed.wait(lock, [&]() { return stop || fields.size() < validate_fields; });
+                                if (!stop)
+                                    fields.push_back(std::move(field));
+                            }
+                            changed.notify_all();
+                        }
+                    );
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                done = true;
+                changed.notify_all();
+            });
+
+            types::real_t diff = 0, norm = 0;
+            auto missing = false;
+            try {
+                _solve<types::complex_t>(boundary_conditions, init, k0, k_j, phi_j,
+                    [&](const auto& x, const auto& data) {
+                        std::optional<ample::utils::tensor<types::single_complex_t, 2>> field;
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            changed.wait(lock, [&]() { return done || !fields.empty(); });
+                            if (!fields.empty()) {
+                                field.emplace(std::move(fields.front()));
+                                fields.pop_front();
+                            }
+                        }
+                        changed.notify_all();
+
+                        if (!field)
+                            missing = true;
+                        else
+                            for (size_t y = 0; y < data.size(); ++y)
+                                for (size_t z = 0; z < data[y].size(); ++z) {
+                                    diff = std::max(diff, std::abs(data(y, z) - types::complex_t((*field)(y, z))));
+                                    norm = std::max(norm, std::abs(data(y, z)));
+                                }
+
+                        callback(x, data);
+                    }
+                );
+            } catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                changed.notify_all();
+                single.join();
+                throw;
+            }
+
+            single.join();
+            if (error)
+                std::rethrow_exception(error);
+            ample::utils::dynamic_assert(!missing, "Single precision solution has fewer fields than double one");
+
+            const auto relative = norm > 0 ? diff / norm : diff;
+            _owner._meta["precision_difference"].push_back({ { "absolute", diff }, { "relative", relative } });
+            verboseln(0, "Single precision difference: absolute ", diff, ", relative to field maximum ", relative);
+        }
+
     };
 
 };
@@ -1308,7 +1552,9 @@ int main(int argc, const char* argv[]) {
         size_t num_workers, buff_size;
         computation.add_options()
             ("workers,w", po::value(&jobs_config.num_workers)->default_value(1), "Number of workers for computation")
-            ("buff,b", po::value(&jobs_config.buff_size)->default_value(100), "Buff size to be used during multi-threaded computation");
+            ("buff,b", po::value(&jobs_config.buff_size)->default_value(100), "Buff size to be used during multi-threaded computation")
+            ("precision", po::value(&jobs_config.precision)->default_value("double"),
+                "Precision of marching: double, single or validate to run both and report the difference");
 
         po::options_description options;
         options.add_options()
@@ -1327,6 +1573,9 @@ int main(int argc, const char* argv[]) {
             return 0;
         }
 
+        if (available_precisions.find(jobs_config.precision) == available_precisions.end())
+            throw std::logic_error(std::string("Unknown precision: ") + jobs_config.precision);
+
         jobs_config.binary = vm.count("binary");
         jobs_config.perform();
 
@@ -2,11 +2,14 @@
 #include <cmath>
 #include <tuple>
 #include <string>
+#include <limits>
 #include <cstddef>
+#include <algorithm>
 #include <functional>
 #include "utils/types.hpp"
 #include "utils/utils.hpp"
 #include "utils/assert.hpp"
+#include "utils/tensor.hpp"
 #include "nlohmann/json.hpp"
 #include "utils/interpolation.hpp"
 
@@ -60,25 +63,29 @@ namespace ample {
 
         public:
 
+            //off diagonals do not depend on wavenumbers, so they are written here once together with boundary rows,
+            //and diagonals are kept as a per mode and term offset of the row plus bk * (k^2 - k0^2), the offsets of
+            //every pml row being tabulated here as well
             band_builder(const pml_boundary_conditions& owner, const types::vector1d_t<VL>& k0,
                          const types::vector2d_t<V>& b, const A& y0, const A& y1, const size_t& ny)
-                         : _owner(owner), _nm(k0.size()), _ny(ny + 2 * owner._width), _nc(b[0].size()), _b(b), _k0(k0),
-                           _ac(_nm, types::vector2d_t<V>(_nc, types::vector1d_t<V>(_ny))),
-                           _bc(_nm, types::vector2d_t<V>(_nc, types::vector1d_t<V>(_ny))),
-                           _cc(_nm, types::vector2d_t<V>(_nc, types::vector1d_t<V>(_ny))) {
+                         : _owner(owner), _nm(k0.size()), _ny(ny + 2 * owner._width), _nc(b[0].size()),
+                           _ac({ _ny, _nm, _nc }), _bc({ _ny, _nm, _nc }), _cc({ _ny, _nm, _nc }),
+                           _sq_k0(_nm), _bk({ _nm, _nc }), _pd({ owner._width + 1, _nm, _nc }),
+                           _sq({ _nm, _ny }, VL(std::numeric_limits<A>::quiet_NaN())) {
+                const auto nw = owner._width;
                 const auto hy = (y1 - y0) / (ny - 1);
-                _y0 = y0 - _owner._width * hy;
-                _y1 = y1 + _owner._width * hy;
+                _y0 = y0 - nw * hy;
+                _y1 = y1 + nw * hy;
                 _sq_hy = std::pow(hy, 2);
 
-                _c1.resize(owner._width);
-                _c2.resize(owner._width);
-                _c3.resize(owner._width);
+                _c1.resize(nw);
+                _c2.resize(nw);
+                _c3.resize(nw);
 
                 auto y = on;
-                const auto dy = on / _owner._width;
+                const auto dy = on / nw;
                 const auto d2 = dy / tw;
-                for (size_t i = 0; i < owner._width; ++i, y -= dy) {
+                for (size_t i = 0; i < nw; ++i, y -= dy) {
                     const auto aa = on + im * owner._function(y - d2);
                     const auto bb = on + im * owner._function(y);
                     const auto cc = on + im * owner._function(y + d2);
@@ -87,48 +94,53 @@ namespace ample {
                     _c2[i] = on / bb * (on / aa + on / cc) / _sq_hy;
                     _c3[i] = on / (cc * bb);
                 }
-            }
-
-            void update(const types::vector2d_t<VL>& k) {
-                update(k, 0, _nm);
-            }
-
-            void update(const types::vector2d_t<VL>& k, const size_t& j0, const size_t& j1) {
-                for (size_t j = j0; j < j1; ++j) {
-                    const auto sq_k0 = std::pow(_k0[j], 2);
 
+                //row l < nw of _pd is the offset of pml rows l and _ny - 1 - l, row nw is the one of the interior
+                const auto ty = tw / _sq_hy;
+                for (size_t j = 0; j < _nm; ++j) {
+                    const auto sq_k0 = _sq_k0[j] = k0[j] * k0[j];
                     for (size_t i = 0; i < _nc; ++i) {
-                        const auto bk = _b[j][i] / sq_k0;
+                        const auto bk = _bk(j, i) = b[j][i] / sq_k0;
                         const auto dd = bk / _sq_hy;
-                        const auto ty = tw / _sq_hy;
-
-                        _ac[j][i].front() = _ac[j][i].back() = _cc[j][i].front() = _cc[j][i].back() = ze;
-                        _bc[j][i].front() = _bc[j][i].back() = on;
-
-                        size_t yi = 1;
 
-                        const auto kf = std::pow(k[j].front(), 2);
-                        for (size_t l = 1; l < _owner._width; ++l, ++yi) {
-                            _ac[j][i][yi] = dd * _c1[l];
-                            _bc[j][i][yi] = on + bk * (kf - sq_k0 - _c2[l]);
-                            _cc[j][i][yi] = dd * _c3[l];
-                        }
+                        _set(0, j, i, ze, on, ze);
+                        _set(_ny - 1, j, i, ze, on, ze);
 
-                        for (size_t l = 0; l < _ny - 2 * _owner._width; ++l, ++yi) {
-                            _ac[j][i][yi] = _cc[j][i][yi] = dd;
-                            _bc[j][i][yi] = on + bk * (std::pow(k[j][l], 2) - sq_k0 - ty);
+                        for (size_t l = 1; l < nw; ++l) {
+                            _pd(l, j, i) = on - bk * _c2[l];
+                            _set(l, j, i, dd * _c1[l], ze, dd * _c3[l]);
+                            _set(_ny - 1 - l, j, i, dd * _c1[l], ze, dd * _c3[l]);
                         }
 
-                        const auto kb = std::pow(k[j].back(), 2);
-                        for (size_t l = _owner._width - 1; l > size_t(0); --l, ++yi) {
-                            _ac[j][i][yi] = dd * _c1[l];
-                            _bc[j][i][yi] = on + bk * (kb - sq_k0 - _c2[l]);
-                            _cc[j][i][yi] = dd * _c3[l];
-                        }
+                        _pd(nw, j, i) = on - bk * ty;
+                        for (size_t yi = nw; yi < _ny - nw; ++yi)
+                            _set(yi, j, i, dd, ze, dd);
                     }
                 }
             }
 
+            bool update(const types::vector2d_t<VL>& k) {
+                return update(k, 0, _nm);
+            }
+
+            bool update(const types::vector2d_t<VL>& k, const size_t& j0, const size_t& j1) {
+                return update(k, j0, j1, 0, _ny);
+            }
+
+            //only diagonals of rows [r0, r1) of modes [j0, j1) are updated, and a row is skipped when the square
+            //of its wavenumber is the same as the last time it was written; returns whether any row has changed
+            bool update(const types::vector2d_t<VL>& k, const size_t& j0, const size_t& j1, const size_t& r0, const size_t& r1) {
+                return _update(j0, j1, r0, r1, [&](const size_t& j, const size_t& l) { return k[j][l]; });
+            }
+
+            //wavenumbers of mode j are ka[j] + t[j] * (kb[j] - ka[j]), rows ka and kb being taken at two range nodes
+            //of modes linear in range; k^2 is then quadratic in t, so the blend is applied to k and squared
+            //rather than to bands, and it is exact at every t
+            bool update(const types::vector2d_t<VL>& ka, const types::vector2d_t<VL>& kb, const types::vector1d_t<A>& t,
+                        const size_t& j0, const size_t& j1, const size_t& r0, const size_t& r1) {
+                return _update(j0, j1, r0, r1, [&](const size_t& j, const size_t& l) { return ka[j][l] + t[j] * (kb[j][l] - ka[j][l]); });
+            }
+
             [[nodiscard]] auto coefficients() const {
                 return std::tie(_ac, _bc, _cc);
             }
@@ -145,17 +157,77 @@ namespace ample {
                 return _ny;
             }
 
+            //bands are stored interleaved as [y][mode][term], this is the distance between consecutive y
+            [[nodiscard]] auto ld() const {
+                return _nm * _nc;
+            }
+
         private:
 
             const pml_boundary_conditions& _owner;
 
             A _sq_hy{}, _y0, _y1;
             const size_t _nm, _ny, _nc;
-            const types::vector2d_t<V>& _b;
-            const types::vector1d_t<VL>& _k0;
 
             types::vector1d_t<V> _c1, _c2, _c3;
-            types::vector3d_t<V> _ac, _bc, _cc;
+            utils::tensor<V, 3> _ac, _bc, _cc;
+
+            //k0^2 of every mode, bk = b / k0^2 of every mode and term, diagonal offsets of pml rows and the interior,
+            //and squares of wavenumbers the diagonal of every row was last written with
+            types::vector1d_t<VL> _sq_k0;
+            utils::tensor<V, 2> _bk;
+            utils::tensor<V, 3> _pd;
+            utils::tensor<VL, 2> _sq;
+
+            //k(j, l) is the wavenumber of mode j at the l-th point of the mesh without pml
+            template<typename K>
+            bool _update(const size_t& j0, const size_t& j1, const size_t& r0, const size_t& r1, const K& k) {
+                const auto nw = _owner._width;
+                const auto nl = _ny - 2 * nw;
+                //without pml the first and the last rows are interior ones
+                const auto y0 = nw > 0 ? std::max(r0, size_t(1)) : r0;
+                const auto y1 = nw > 0 ? std::min(r1, _ny - 1) : r1;
+
+                auto changed = false;
+                for (size_t j = j0; j < j1; ++j) {
+                    const VL kf = k(j, 0), kb = k(j, nl - 1);
+                    const auto bk = &_bk(j, 0);
+                    const auto sq = &_sq(j, 0);
+
+                    const auto row = [&](const size_t& yi, const size_t& l, const VL& s) {
+                        if (s == sq[yi])
+                            return;
+
+                        sq[yi] = s;
+                        changed = true;
+
+                        const auto ds = s - _sq_k0[j];
+                        const auto pd = &_pd(l, j, 0);
+                        const auto bc = &_bc(yi, j, 0);
+                        for (size_t i = 0; i < _nc; ++i)
+                            bc[i] = pd[i] + bk[i] * ds;
+                    };
+
+                    for (auto yi = y0; yi < std::min(y1, nw); ++yi)
+                        row(yi, yi, kf * kf);
+
+                    for (auto yi = std::max(y0, nw); yi < std::min(y1, _ny - nw); ++yi) {
+                        const VL kl = k(j, yi - nw);
+                        row(yi, nw, kl * kl);
+                    }
+
+                    for (auto yi = std::max(y0, _ny - nw); yi < y1; ++yi)
+                        row(yi, _ny - 1 - yi, kb * kb);
+                }
+
+                return changed;
+            }
+
+            void _set(const size_t& y, const size_t& j, const size_t& i, const V& a, const V& b, const V& c) {
+                _ac(y, j, i) = a;
+                _bc(y, j, i) = b;
+                _cc(y, j, i) = c;
+            }
 
         };
 
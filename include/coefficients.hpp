@@ -1,10 +1,23 @@
 #pragma once
 #include <cmath>
+#include <mutex>
 #include <tuple>
+#include <memory>
+#include <string>
+#include <complex>
 #include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <sstream>
 #include <utility>
+#include <iomanip>
+#include <optional>
 #include <algorithm>
+#include <filesystem>
 #include <functional>
+#include <type_traits>
+#include <unordered_map>
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
@@ -183,6 +196,156 @@ namespace ample {
             return result;
         }
 
+        template<typename T>
+        T round_to(const T& value, const T& step) {
+            return std::round(value / step) * step;
+        }
+
+        template<typename T>
+        std::complex<T> round_to(const std::complex<T>& value, const T& step) {
+            return { round_to(value.real(), step), round_to(value.imag(), step) };
+        }
+
+        template<typename T>
+        void append_bytes(std::string& result, const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be appended");
+            result.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        //identifies a kind of coefficients: its type, value type and parameters
+        template<typename T, typename... Args>
+        std::string coefficients_name(const std::string& type, const Args&... args) {
+            auto result = type;
+            append_bytes(result, std::uint64_t(sizeof(T)));
+            (append_bytes(result, args), ...);
+            return result;
+        }
+
+        //results of coefficients::get for one kind of coefficients by their argument; every coefficients of the kind
+        //in the process share one table, which may also be kept in a file that every new result is appended to
+        template<typename T>
+        class coefficients_table {
+
+        public:
+
+            using value_t = std::tuple<T, types::vector1d_t<T>, types::vector1d_t<T>>;
+
+            coefficients_table(std::string name, const size_t& m) : _name(std::move(name)), _m(m) {}
+
+            static std::shared_ptr<coefficients_table> get(const std::string& name, const size_t& m) {
+                static std::mutex mutex;
+                static std::unordered_map<std::string, std::shared_ptr<coefficients_table>> tables;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& result = tables[name];
+                if (!result)
+                    result = std::make_shared<coefficients_table>(name, m);
+                return result;
+            }
+
+            //results stored in directory path are loaded, and new ones are stored there from now on
+            void persist(const std::filesystem::path& path) {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                std::ostringstream name;
+                name << "coefficients_" << std::hex << std::setw(16) << std::setfill('0') << _hash(_name) << ".bin";
+                const auto filename = path / name.str();
+                if (filename == _file)
+                    return;
+
+                std::filesystem::create_directories(path);
+                _file = filename;
+                _load();
+            }
+
+            std::optional<value_t> find(const T& argument) const {
+                std::lock_guard<std::mutex> lock(_mutex);
+                const auto it = _data.find(_key(argument));
+                if (it == _data.end())
+                    return std::nullopt;
+                return it->second;
+            }
+
+            void store(const T& argument, const value_t& value) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_data.try_emplace(_key(argument), value).second || _file.empty())
+                    return;
+
+                //a record cut short by a crash is dropped when the file is loaded, so records are always appended whole
+                std::string record;
+                append_bytes(record, argument);
+                append_bytes(record, std::get<0>(value));
+                for (const auto& it : { &std::get<1>(value), &std::get<2>(value) })
+                    for (size_t i = 0; i < _m; ++i)
+                        append_bytes(record, (*it)[i]);
+
+                std::ofstream file(_file, std::ios_base::binary | std::ios_base::app);
+                file.write(record.data(), record.size());
+            }
+
+        private:
+
+            const std::string _name;
+            const size_t _m;
+            std::filesystem::path _file;
+            mutable std::mutex _mutex;
+            std::unordered_map<std::string, value_t> _data;
+
+            static std::string _key(const T& argument) {
+                std::string result;
+                append_bytes(result, argument);
+                return result;
+            }
+
+            //a file starts with the name of its kind, so a hash collision leaves the file alone; a partial record
+            //at the end is cut off, otherwise every record appended after it would be read misaligned
+            void _load() {
+                std::ifstream file(_file, std::ios_base::binary);
+                if (!file) {
+                    std::string header;
+                    append_bytes(header, std::uint64_t(_name.size()));
+                    header += _name;
+                    std::ofstream(_file, std::ios_base::binary).write(header.data(), header.size());
+                    return;
+                }
+
+                std::uint64_t size = 0;
+                std::string name;
+                if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size != _name.size() ||
+                    !file.read((name = std::string(size, '\0')).data(), size) || name != _name) {
+                    _file.clear();
+                    return;
+                }
+
+                T argument;
+                value_t value{ T(0), types::vector1d_t<T>(_m), types::vector1d_t<T>(_m) };
+                const auto read = [&file](T& x) { return bool(file.read(reinterpret_cast<char*>(&x), sizeof(x))); };
+
+                auto end = sizeof(size) + size;
+                while (read(argument) && read(std::get<0>(value)) &&
+                       std::all_of(std::get<1>(value).begin(), std::get<1>(value).end(), read) &&
+                       std::all_of(std::get<2>(value).begin(), std::get<2>(value).end(), read)) {
+                    _data.try_emplace(_key(argument), value);
+                    end += (2 + 2 * _m) * sizeof(T);
+                }
+
+                file.close();
+                if (std::filesystem::file_size(_file) != end)
+                    std::filesystem::resize_file(_file, end);
+            }
+
+            //fnv-1a
+            static std::uint64_t _hash(const std::string& data) {
+                std::uint64_t result = 14695981039346656037ull;
+                for (const auto& it : data) {
+                    result ^= static_cast<unsigned char>(it);
+                    result *= 1099511628211ull;
+                }
+                return result;
+            }
+
+        };
+
     }// namespace ample::_impl
 
     template<typename T>
@@ -194,20 +357,70 @@ namespace ample {
         using transform_func_t   = std::function<void (types::vector1d_t<T>&, types::vector1d_t<T>&)>;
         using coeficients_func_t = std::function<std::tuple<types::vector1d_t<T>, types::vector1d_t<T>>(const types::vector1d_t<T>&, const size_t&, const size_t&)>;
 
+        using real_t = decltype(std::abs(std::declval<T>()));
+
         coefficients(const size_t& n,
                      taylor_func_t taylor,
                      transform_func_t transform,
-                     coeficients_func_t coefficients) : ample::coefficients<T>(n, n, std::move(taylor), std::move(transform), std::move(coefficients)) {}
+                     coeficients_func_t coefficients,
+                     const std::string& name = "") : ample::coefficients<T>(n, n, std::move(taylor), std::move(transform), std::move(coefficients), name) {}
 
+        //coefficients with a name share results of get with every coefficients of the same name in the process
         coefficients(const size_t& n, const size_t& m,
                      taylor_func_t taylor,
                      transform_func_t transform,
-                     coeficients_func_t coefficients) : _n(n), _m(m), _taylor(std::move(taylor)), _transform(std::move(transform)), _coefficients(std::move(coefficients)) {
+                     coeficients_func_t coefficients,
+                     const std::string& name = "") : _n(n), _m(m), _taylor(std::move(taylor)), _transform(std::move(transform)), _coefficients(std::move(coefficients)) {
             utils::dynamic_assert(n > 0,  "coefficients: n(", n, ") must be positive");
             utils::dynamic_assert(n <= m, "coefficients: n(", n, ") must be less or equal to m(", m, ")");
+            if (!name.empty())
+                _table = _impl::coefficients_table<T>::get(name, m);
+        }
+
+        //shared results are also kept in directory path unless it is empty; if tolerance is positive, arguments are rounded
+        //to a power of two that is no greater than tolerance * |argument| first, so close arguments share their results
+        coefficients& cache(const std::filesystem::path& path, const real_t& tolerance = real_t(0)) {
+            utils::dynamic_assert(tolerance >= 0, "coefficients: tolerance(", tolerance, ") must be non-negative");
+            _tolerance = tolerance;
+            if (_table && !path.empty())
+                _table->persist(path);
+            return *this;
         }
 
         auto get(const T& value) const {
+            if (!_table)
+                return _get(value);
+
+            const auto argument = _round(value);
+            if (auto result = _table->find(argument))
+                return std::move(result.value());
+
+            auto result = _get(argument);
+            _table->store(argument, result);
+            return result;
+        }
+
+        [[nodiscard]] auto nc() const {
+            return _m;
+        }
+
+    private:
+
+        size_t _n{}, _m{};
+        real_t _tolerance{};
+        taylor_func_t _taylor;
+        transform_func_t _transform;
+        coeficients_func_t _coefficients;
+        std::shared_ptr<_impl::coefficients_table<T>> _table;
+
+        T _round(const T& value) const {
+            const auto scale = _tolerance * std::abs(value);
+            if (!(scale > 0))
+                return value;
+            return _impl::round_to(value, std::exp2(std::floor(std::log2(scale))));
+        }
+
+        typename _impl::coefficients_table<T>::value_t _get(const T& value) const {
             const auto tc = _taylor(value, _n + _m + 1);
             auto [np, dp] = _coefficients(tc, _n, _m);
 
@@ -235,22 +448,12 @@ namespace ample {
             return std::make_tuple(a0, std::move(a), utils::make_vector(dr, [](const auto& x) { return -T(1) / x; }));
         }
 
-        [[nodiscard]] auto nc() const {
-            return _m;
-        }
-
-    private:
-
-        size_t _n{}, _m{};
-        taylor_func_t _taylor;
-        transform_func_t _transform;
-        coeficients_func_t _coefficients;
-
     };
 
     template<typename T>
     auto ssp_coefficients(const size_t& n, const size_t& m) {
-        return coefficients<T>(n, m, _impl::exp_taylor<T>{}, _impl::no_transform<T>{}, _impl::pade_coefficients<T>{});
+        return coefficients<T>(n, m, _impl::exp_taylor<T>{}, _impl::no_transform<T>{}, _impl::pade_coefficients<T>{},
+                               _impl::coefficients_name<T>("ssp", n, m));
     }
 
     template<typename T>
@@ -260,12 +463,14 @@ namespace ample {
 
     template<typename T>
     auto theta_ssp_coefficients(const size_t& n, const T& theta) {
-        return coefficients<T>(n, n, _impl::exp_taylor<T>{}, _impl::no_transform<T>{}, _impl::theta_pade_coefficients<T>{ theta });
+        return coefficients<T>(n, n, _impl::exp_taylor<T>{}, _impl::no_transform<T>{}, _impl::theta_pade_coefficients<T>{ theta },
+                               _impl::coefficients_name<T>("theta_ssp", n, theta));
     }
 
     template<typename T>
     auto wampe_coefficients(const size_t& n, const size_t& m) {
-        return coefficients<T>(n, m, _impl::root_taylor<T>{}, _impl::wampe_transform<T>{}, _impl::pade_coefficients<T>{});
+        return coefficients<T>(n, m, _impl::root_taylor<T>{}, _impl::wampe_transform<T>{}, _impl::pade_coefficients<T>{},
+                               _impl::coefficients_name<T>("wampe", n, m));
     }
 
     template<typename T>
@@ -275,7 +480,8 @@ namespace ample {
 
     template<typename T>
     auto theta_wampe_coefficients(const size_t& n, const T& theta) {
-        return coefficients<T>(n, n, _impl::root_taylor<T>{}, _impl::wampe_transform<T>{}, _impl::theta_pade_coefficients<T>{ theta });
+        return coefficients<T>(n, n, _impl::root_taylor<T>{}, _impl::wampe_transform<T>{}, _impl::theta_pade_coefficients<T>{ theta },
+                               _impl::coefficients_name<T>("theta_wampe", n, theta));
     }
 
 }// namespace ample
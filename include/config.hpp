@@ -229,10 +229,10 @@ namespace ample {
         continue;                                                           \
     }
 
-#define MAKE_COEFFICIENTS(name, kind, check, type, ...) \
-    if (name == kind) {                                 \
-        check;                                          \
-        return type(__VA_ARGS__);                       \
+#define MAKE_COEFFICIENTS(name, kind, check, type, ...)                                 \
+    if (name == kind) {                                                                 \
+        check;                                                                          \
+        return type(__VA_ARGS__).cache(coefficients_cache(), coefficients_tolerance()); \
     } else
 
 #define THIS_OR_THAT(data, type, this, that) data.template contains(this) ? data[this].template get<type>() : data[that].template get<type>()
@@ -364,8 +364,13 @@ namespace ample {
         CONFIG_DATA_FIELD(complex_modes, bool)
         CONFIG_DATA_FIELD(const_modes, bool)
         CONFIG_DATA_FIELD(additive_depth, bool)
+        CONFIG_DATA_FIELD(mode_continuation, bool)
         CONFIG_DATA_FIELD(past_n, size_t)
         CONFIG_DATA_FIELD(border_width, size_t)
+        CONFIG_DATA_FIELD(modes_slab, size_t)
+        CONFIG_DATA_FIELD(modes_slab_workers, size_t)
+        CONFIG_DATA_FIELD(modes_step, size_t)
+        CONFIG_DATA_FIELD(modes_tolerance, T)
         CONFIG_DATA_FIELD(a0, T)
         CONFIG_DATA_FIELD(a1, T)
         CONFIG_DATA_FIELD(na, size_t)
@@ -373,11 +378,16 @@ namespace ample {
         CONFIG_DATA_FIELD(l1, T)
         CONFIG_DATA_FIELD(nl, size_t)
         CONFIG_DATA_FIELD(init, std::string)
+        CONFIG_DATA_FIELD(modes_cache, std::string)
+        CONFIG_DATA_FIELD(mode_tensors, std::string)
+        CONFIG_DATA_FIELD(eigen_type, std::string)
         CONFIG_DATA_FIELD(tolerance, T)
         CONFIG_DATA_FIELD(reference_index, size_t)
         CONFIG_DATA_FIELD(sel_range, types::tuple2_t<T>)
         CONFIG_DATA_FIELD(sel_strict, bool)
         CONFIG_DATA_FIELD(coefficients, utils::object_descriptor)
+        CONFIG_DATA_FIELD(coefficients_cache, std::string)
+        CONFIG_DATA_FIELD(coefficients_tolerance, T)
         CONFIG_DATA_FIELD(boundary_conditions, utils::object_descriptor)
         CONFIG_DATA_FIELD(tapering, utils::object_descriptor)
 
@@ -457,30 +467,54 @@ namespace ample {
             _data["mnz"] = n;
         }
 
+        //whether modes of the field are given as input data instead of being computed
+        template<typename V = T>
+        [[nodiscard]] bool has_modes() const {
+            return _k_j.template has_value<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>() && _phi_j.has_value();
+        }
+
         template<typename V = T>
         auto create_modes(const size_t& num_workers = 1, const size_t& c = 0, const bool show_progress = false) const {
-            if (_k_j.template has_value<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>() &&
-                _phi_j.has_value()) {
-                const auto& k_j = std::get<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>(_k_j)[_index];
-                const auto& phi_j = _phi_j.value()[_index];
-                utils::dynamic_assert(k_j.size() >= c,
-                      "Insufficient number of modes. Expect no less than ", c, ", but got ", k_j.size());
-                utils::dynamic_assert(phi_j.size() >= c,
-                      "Insufficient number of modes. Expect no less than ", c, ", but got ", phi_j.size());
-                return std::make_tuple(k_j, phi_j);
-            }
+            modes<T, V> modes(*this, utils::mesh_1d(z0(), z1(), mnz()));
+            return create_modes(modes, num_workers, c, show_progress);
+        }
+
+        //modes of the current frequency given as input data, they are interpolated on their own meshes as loaded
+        template<typename V = T>
+        auto input_modes(const size_t& c = 0) const {
+            utils::dynamic_assert(has_modes<V>(), "Modes must be given as input data");
+
+            const auto& k_j = std::get<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>(_k_j)[_index];
+            const auto& phi_j = _phi_j.value()[_index];
+            utils::dynamic_assert(k_j.size() >= c,
+                  "Insufficient number of modes. Expect no less than ", c, ", but got ", k_j.size());
+            utils::dynamic_assert(phi_j.size() >= c,
+                  "Insufficient number of modes. Expect no less than ", c, ", but got ", phi_j.size());
+            return std::make_tuple(k_j, phi_j);
+        }
+
+        //modes of the current frequency computed by modes that are kept between frequencies, see modes::frequency,
+        //modes given as input data are taken by input_modes as they are kept on meshes of their own
+        template<typename V = T>
+        auto create_modes(modes<T, V>& modes, const size_t& num_workers = 1, const size_t& c = 0, const bool show_progress = false) const {
+            utils::dynamic_assert(!has_modes<V>(), "Modes given as input data must be taken by input_modes");
 
             const auto xn = mnx();
             const auto yn = mny();
 
-            modes<T, V> modes(*this, utils::mesh_1d(z0(), z1(), mnz()));
+            modes.frequency(f());
             return modes.interpolated_field(xn, yn, utils::progress_bar_callback(xn * yn, "Modes", show_progress), num_workers, c);
         }
 
         template<typename V = T>
         auto create_const_modes(const size_t& num_workers = 1, const size_t& c = 0, const bool show_progress = false) const {
-            if (_k_j.template has_value<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>() &&
-                _phi_j.has_value()) {
+            modes<T, V> modes(*this, utils::mesh_1d(z0(), z1(), mnz()));
+            return create_const_modes(modes, num_workers, c, show_progress);
+        }
+
+        template<typename V = T>
+        auto create_const_modes(modes<T, V>& modes, const size_t& num_workers = 1, const size_t& c = 0, const bool show_progress = false) const {
+            if (has_modes<V>()) {
                 const auto& k_j = std::get<types::vector1d_t<utils::linear_interpolated_data_2d<T, V>>>(_k_j)[_index];
                 const auto& phi_j = _phi_j.value()[_index];
                 utils::dynamic_assert(k_j.size() >= c,
@@ -504,7 +538,10 @@ namespace ample {
                 );
             }
 
-            return create_const_modes<V>(utils::mesh_1d(z0(), z1(), mnz()), num_workers, c, show_progress);
+            const auto yn = mny();
+
+            modes.frequency(f());
+            return modes.interpolated_line(x0(), yn, utils::progress_bar_callback(yn, "Modes", show_progress), num_workers, c);
         }
 
         template<typename V = T>
@@ -583,8 +620,13 @@ namespace ample {
                 { "complex_modes", true },
                 { "const_modes", true },
                 { "additive_depth", false },
+                { "mode_continuation", false },
                 { "past_n", size_t(0) },
                 { "border_width", size_t(10) },
+                { "modes_slab", size_t(0) },
+                { "modes_slab_workers", size_t(1) },
+                { "modes_step", size_t(8) },
+                { "modes_tolerance", T(0) },
                 { "a0", -T(M_PI) / T(4) },
                 { "a1",  T(M_PI) / T(4) },
                 { "na", size_t(90) },
@@ -592,6 +634,9 @@ namespace ample {
                 { "l1", T(4000) },
                 { "nl", size_t(4001) },
                 { "init", "greene" },
+                { "modes_cache", "" },
+                { "mode_tensors", "" },
+                { "eigen_type", "alglib" },
                 { "tapering",
                     {
                         { "type", "angled" },
@@ -606,6 +651,8 @@ namespace ample {
                 { "reference_index", size_t(0) },
                 { "sel_range", { T(-1), T(-1) } },
                 { "sel_strict", false },
+                { "coefficients_cache", "" },
+                { "coefficients_tolerance", T(0) },
                 { "coefficients",
                     {
                         { "type", "ssp" },
@@ -0,0 +1,376 @@
+#pragma once
+#include <cmath>
+#include <tuple>
+#include <limits>
+#include <cstddef>
+#include <optional>
+#include <algorithm>
+#include "normal_modes.h"
+#include "utils/types.hpp"
+
+namespace ample {
+
+    //finite difference modal problem of the layered medium given by inputs of NormalModes, every layer is split
+    //into M_Ns_points * m steps and density jumps are handled by the usual interface scheme; the operator is
+    //symmetric with respect to integration weights of phi^2 / rho, so after scaling it is a symmetric tridiagonal
+    //matrix whose eigenvalues are squared horizontal wavenumbers and whose unit eigenvectors are normalized modes
+    template<typename T = types::real_t>
+    class modal_problem {
+
+    public:
+
+        modal_problem(const NormalModes& n_m, const size_t& m) {
+            const auto nl = n_m.M_depths.size();
+            const auto omega = 2 * T(M_PI) * n_m.f;
+            const auto scale = 40 * T(M_PI) * std::log10(std::exp(T(1)));
+
+            types::vector1d_t<T> h(nl);
+            types::vector1d_t<size_t> ns(nl);
+            for (size_t l = 0; l < nl; ++l) {
+                ns[l] = std::max(size_t(1), size_t(n_m.M_Ns_points[l]) * m);
+                h[l] = (n_m.M_depths[l] - (l ? n_m.M_depths[l - 1] : T(0))) / ns[l];
+            }
+
+            const auto q = [&](const size_t& l, const size_t& i) {
+                const auto c = n_m.M_c1s[l] + (n_m.M_c2s[l] - n_m.M_c1s[l]) * i / ns[l];
+                return std::pow(omega / c, 2);
+            };
+
+            //a is the lower and c is the upper band of the operator, w are integration weights
+            types::vector1d_t<T> a, b, c, w;
+            _z.push_back(T(0));
+            for (size_t l = 0; l < nl; ++l) {
+                const auto r = n_m.M_rhos[l];
+                const auto eta = n_m.M_betas[l] / scale;
+                const auto sq = h[l] * h[l];
+
+                for (size_t i = l ? 0 : 1; i < ns[l]; ++i) {
+                    _z.push_back((l ? n_m.M_depths[l - 1] : T(0)) + i * h[l]);
+
+                    if (i > 0) {
+                        a.push_back(1 / sq);
+                        b.push_back(q(l, i) - 2 / sq);
+                        c.push_back(1 / sq);
+                        w.push_back(h[l] / r);
+                        _v.push_back(h[l] / r * q(l, i) * eta);
+                        continue;
+                    }
+
+                    const auto pr = n_m.M_rhos[l - 1];
+                    const auto ph = h[l - 1];
+                    const auto hh = ph / (2 * pr) + h[l] / (2 * r);
+                    a.push_back(1 / (pr * ph * hh));
+                    c.push_back(1 / (r * h[l] * hh));
+                    b.push_back((ph / (2 * pr) * q(l - 1, ns[l - 1]) + h[l] / (2 * r) * q(l, 0)) / hh - a.back() - c.back());
+                    w.push_back(hh);
+                    _v.push_back(ph / (2 * pr) * q(l - 1, ns[l - 1]) * n_m.M_betas[l - 1] / scale + h[l] / (2 * r) * q(l, 0) * eta);
+                }
+            }
+
+            const auto n = b.size();
+            _d = std::move(b);
+            _e.resize(n ? n - 1 : 0);
+            _s.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                _s[i] = std::sqrt(w[i]);
+                if (i + 1 < n)
+                    _e[i] = std::sqrt(c[i] * a[i + 1]);
+                _norm = std::max(_norm, std::abs(_d[i]) + 2 * (i + 1 < n ? _e[i] : T(0)));
+            }
+
+            _z.push_back(n_m.M_depths.back());
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _d.size();
+        }
+
+        //number of eigenvalues greater than s, from signs of the ldl factorization of the shifted matrix
+        [[nodiscard]] size_t count(const T& s) const {
+            size_t result = 0;
+            auto p = T(1);
+            for (size_t i = 0; i < _d.size(); ++i) {
+                p = _d[i] - s - (i ? _e[i - 1] * _e[i - 1] / p : T(0));
+                if (p == 0)
+                    p = -std::numeric_limits<T>::epsilon() * (std::abs(_d[i]) + std::abs(s));
+                result += p > 0;
+            }
+            return result;
+        }
+
+        //eigenpair nearest to s refined by inverse and then rayleigh quotient iterations, empty if it does not converge
+        [[nodiscard]] std::optional<std::tuple<T, types::vector1d_t<T>>> refine(const T& s) const {
+            const auto n = _d.size();
+            if (n == 0)
+                return std::nullopt;
+
+            types::vector1d_t<T> x(n, T(1) / std::sqrt(T(n))), p(n);
+            for (size_t k = 0; k < 3; ++k)
+                _inverse(s, x, p);
+
+            auto l = _quotient(x);
+            for (size_t k = 0; k < max_iterations; ++k) {
+                _inverse(l, x, p);
+                const auto r = _quotient(x);
+                if (std::abs(r - l) <= tolerance * _norm)
+                    return std::make_tuple(r, std::move(x));
+                l = r;
+            }
+
+            return std::nullopt;
+        }
+
+        //gershgorin bounds of the spectrum
+        [[nodiscard]] std::tuple<T, T> bounds() const {
+            auto l = T(0), h = T(0);
+            for (size_t i = 0; i < _d.size(); ++i) {
+                const auto r = (i ? _e[i - 1] : T(0)) + (i + 1 < _d.size() ? _e[i] : T(0));
+                l = i ? std::min(l, _d[i] - r) : _d[i] - r;
+                h = i ? std::max(h, _d[i] + r) : _d[i] + r;
+            }
+            return { l, h };
+        }
+
+        //j-th largest eigenvalue (from zero) known to lie in [l, h], bisection of sturm counts
+        [[nodiscard]] T eigenvalue(const size_t& j, T l, T h) const {
+            while (h - l > tolerance * _norm) {
+                const auto s = (l + h) / 2;
+                if (s <= l || s >= h)
+                    break;
+                (count(s) > j ? l : h) = s;
+            }
+            return (l + h) / 2;
+        }
+
+        //unit eigenvector of eigenvalue s known to full precision, inverse iteration with a fixed shift
+        [[nodiscard]] types::vector1d_t<T> vector(const T& s) const {
+            const auto n = _d.size();
+            types::vector1d_t<T> x(n, T(1) / std::sqrt(T(n))), p(n);
+            for (size_t k = 0; k < 3; ++k)
+                _inverse(s, x, p);
+            return x;
+        }
+
+        //mode with unit eigenvector y at depths z, it is normalized so that the integral of phi^2 / rho is one
+        [[nodiscard]] types::vector1d_t<T> function(const types::vector1d_t<T>& y, const types::vector1d_t<T>& z) const {
+            types::vector1d_t<T> result(z.size(), T(0));
+            for (size_t k = 0; k < z.size(); ++k) {
+                if (z[k] <= 0 || z[k] >= _z.back())
+                    continue;
+
+                const auto i = size_t(std::upper_bound(_z.begin(), _z.end(), z[k]) - _z.begin());
+                const auto y0 = i > 1 ? y[i - 2] / _s[i - 2] : T(0);
+                const auto y1 = i <= y.size() ? y[i - 1] / _s[i - 1] : T(0);
+                result[k] = y0 + (y1 - y0) * (z[k] - _z[i - 1]) / (_z[i] - _z[i - 1]);
+            }
+            return result;
+        }
+
+        //imaginary part of wavenumber k of mode y due to attenuation in layers, first order perturbation
+        [[nodiscard]] T attenuation(const T& k, const types::vector1d_t<T>& y) const {
+            auto result = T(0);
+            for (size_t i = 0; i < y.size(); ++i)
+                result += _v[i] * y[i] * y[i] / (_s[i] * _s[i]);
+            return result / k;
+        }
+
+        static constexpr size_t max_iterations = 50;
+        static constexpr T tolerance = std::numeric_limits<T>::epsilon() * 64;
+
+    private:
+
+        //_z are depths of mesh nodes with surface in front, so unknown i is at depth _z[i + 1], and bottom at the end
+        //_s are square roots of integration weights relating eigenvectors to modes, _v are attenuation weights
+        types::vector1d_t<T> _d, _e, _s, _z, _v;
+        T _norm = T(0);
+
+        //x = (A - s)^-1 x normalized, p is a scratch
+        void _inverse(const T& s, types::vector1d_t<T>& x, types::vector1d_t<T>& p) const {
+            const auto n = _d.size();
+            const auto tiny = std::numeric_limits<T>::epsilon() * (std::abs(s) + T(1));
+
+            p[0] = _d[0] - s;
+            for (size_t i = 1; i < n; ++i) {
+                if (std::abs(p[i - 1]) < tiny)
+                    p[i - 1] = tiny;
+                const auto f = _e[i - 1] / p[i - 1];
+                p[i] = _d[i] - s - f * _e[i - 1];
+                x[i] -= f * x[i - 1];
+            }
+
+            if (std::abs(p[n - 1]) < tiny)
+                p[n - 1] = tiny;
+            x[n - 1] /= p[n - 1];
+            for (size_t i = n - 1; i-- > 0;)
+                x[i] = (x[i] - _e[i] * x[i + 1]) / p[i];
+
+            auto norm = T(0);
+            for (const auto& it : x)
+                norm += it * it;
+            norm = std::sqrt(norm);
+            for (auto& it : x)
+                it /= norm;
+        }
+
+        [[nodiscard]] T _quotient(const types::vector1d_t<T>& x) const {
+            auto result = T(0);
+            for (size_t i = 0; i < x.size(); ++i) {
+                result += _d[i] * x[i] * x[i];
+                if (i + 1 < x.size())
+                    result += 2 * _e[i] * x[i] * x[i + 1];
+            }
+            return result;
+        }
+
+    };
+
+    namespace _impl {
+
+        //lagrange interpolation to zero mesh step over squared steps 1 / m^2
+        template<typename T>
+        T richardson_weight(const size_t& m, const size_t& nr) {
+            auto weight = T(1);
+            for (size_t r = 1; r <= nr; ++r)
+                if (r != m)
+                    weight *= T(1) / (r * r) / (T(1) / (r * r) - T(1) / (m * m));
+            return weight;
+        }
+
+        template<typename T>
+        T trapped_cut(const NormalModes& n_m) {
+            return std::pow(2 * T(M_PI) * n_m.f / n_m.M_c2s.back(), 2);
+        }
+
+        //sets wavenumbers, modes and attenuation of n_m from squared wavenumbers sq and eigenvectors y of base
+        template<typename T>
+        void assign_modes(NormalModes& n_m, const modal_problem<T>& base,
+                          const types::vector1d_t<T>& sq, const types::vector2d_t<T>& y, const bool& attenuation) {
+            const auto nm = sq.size();
+            const types::vector1d_t<T> z(n_m.zr.begin(), n_m.zr.end());
+
+            decltype(n_m.mfunctions_zr) functions(nm);
+            decltype(n_m.khs) wavenumbers(nm);
+            decltype(n_m.mattenuation) attenuations(nm);
+            for (size_t j = 0; j < nm; ++j) {
+                wavenumbers[j] = std::sqrt(sq[j]);
+                functions[j] = base.function(y[j], z);
+                if (attenuation)
+                    attenuations[j] = base.attenuation(wavenumbers[j], y[j]);
+
+                //sign follows the previous mode, so modes vary continuously between neighbouring points
+                if (j < n_m.mfunctions_zr.size() && n_m.mfunctions_zr[j].size() == functions[j].size()) {
+                    auto dot = T(0);
+                    for (size_t k = 0; k < functions[j].size(); ++k)
+                        dot += functions[j][k] * n_m.mfunctions_zr[j][k];
+                    if (dot < 0)
+                        for (auto& it : functions[j])
+                            it = -it;
+                }
+            }
+
+            n_m.khs = std::move(wavenumbers);
+            n_m.mfunctions_zr = std::move(functions);
+            if (attenuation)
+                n_m.mattenuation = std::move(attenuations);
+        }
+
+    }// namespace _impl
+
+    //refines wavenumbers and modes of n_m from guesses khs, e.g. wavenumbers of a neighbouring point; every squared
+    //wavenumber is refined on ordRich meshes and richardson extrapolated, which is much cheaper than a full eigen
+    //decomposition; returns false if the refined set can not be proven to be the set of modes a full solution yields
+    //(same number of modes, j-th refined value is exactly the j-th largest eigenvalue), n_m is left untouched then
+    template<typename T = types::real_t>
+    bool continue_modes(NormalModes& n_m, const types::vector1d_t<T>& khs, const bool& attenuation) {
+        const auto nm = khs.size();
+        if (nm == 0 || n_m.iModesSubset >= 0 || (n_m.nmod > 0 && nm != size_t(n_m.nmod)))
+            return false;
+
+        const auto nr = std::max(size_t(1), size_t(n_m.ordRich));
+
+        types::vector1d_t<T> sq(nm, T(0));
+        types::vector2d_t<T> y(nm);
+        std::optional<modal_problem<T>> base;
+
+        for (size_t m = 1; m <= nr; ++m) {
+            modal_problem<T> problem(n_m, m);
+            const auto weight = _impl::richardson_weight<T>(m, nr);
+
+            for (size_t j = 0; j < nm; ++j) {
+                auto pair = problem.refine(khs[j] * khs[j]);
+                if (!pair)
+                    return false;
+
+                auto& [value, vector] = *pair;
+                if (problem.count(value - std::abs(value) * 1e-9) != j + 1)
+                    return false;
+
+                sq[j] += weight * value;
+                if (m == 1)
+                    y[j] = std::move(vector);
+            }
+
+            if (m == 1) {
+                //without a fixed number of modes all trapped ones are expected
+                if (n_m.nmod <= 0 && problem.count(_impl::trapped_cut<T>(n_m)) != nm)
+                    return false;
+                base.emplace(std::move(problem));
+            }
+        }
+
+        if (std::any_of(sq.begin(), sq.end(), [](const auto& it) { return it <= 0; }))
+            return false;
+
+        _impl::assign_modes(n_m, *base, sq, y, attenuation);
+        return true;
+    }
+
+    //native replacement of compute_khs, compute_mfunctions_zr and compute_mattenuation: the trapped modes, or nmod
+    //largest wavenumbers, are found on ordRich meshes by sturm bisection and richardson extrapolated, modes are
+    //eigenvectors of the base mesh found by inverse iteration; every eigenpair costs O(N) instead of a dense solve
+    template<typename T = types::real_t>
+    void solve_modes(NormalModes& n_m, const bool& attenuation) {
+        const auto nr = std::max(size_t(1), size_t(n_m.ordRich));
+
+        size_t nm = 0;
+        types::vector1d_t<T> sq;
+        types::vector2d_t<T> y;
+        std::optional<modal_problem<T>> base;
+
+        for (size_t m = 1; m <= nr; ++m) {
+            modal_problem<T> problem(n_m, m);
+            const auto weight = _impl::richardson_weight<T>(m, nr);
+            auto [l, h] = problem.bounds();
+
+            if (m == 1) {
+                const auto cut = n_m.nmod > 0 ? T(0) : _impl::trapped_cut<T>(n_m);
+                nm = problem.count(cut);
+                if (n_m.nmod > 0)
+                    nm = std::min(nm, size_t(n_m.nmod));
+                l = std::max(l, cut);
+                sq.assign(nm, T(0));
+                y.resize(nm);
+            }
+
+            //eigenvalues are found in decreasing order, so the previous one bounds the next one from above
+            for (size_t j = 0; j < nm; ++j) {
+                h = problem.eigenvalue(j, l, h);
+                sq[j] += weight * h;
+                if (m == 1)
+                    y[j] = problem.vector(h);
+            }
+
+            if (m == 1)
+                base.emplace(std::move(problem));
+        }
+
+        //extrapolation may push the weakest mode over the cut
+        while (nm > 0 && sq[nm - 1] <= 0)
+            --nm;
+        sq.resize(nm);
+        y.resize(nm);
+
+        _impl::assign_modes(n_m, *base, sq, y, attenuation);
+    }
+
+}// namespace ample
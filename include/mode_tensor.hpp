@@ -0,0 +1,231 @@
+#pragma once
+#include <array>
+#include <tuple>
+#include <memory>
+#include <cstddef>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <type_traits>
+#include "utils/types.hpp"
+#include "utils/assert.hpp"
+#include "utils/tensor.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/interpolation.hpp"
+
+namespace ample {
+
+    namespace _impl {
+
+        template<typename V>
+        struct is_complex : std::false_type {};
+
+        template<typename V>
+        struct is_complex<std::complex<V>> : std::true_type {};
+
+    }// namespace _impl
+
+    //wavenumbers k[mode][x][y] and modal functions phi[mode][x][y][z] of the field kept in a single block that is
+    //laid out exactly as its file: a header, meshes x, y, z and both tensors, every part starting at a cache line;
+    //a file is mapped as it is, so modes written by the modes job are used by later runs without being read or parsed
+    template<typename T, typename V = T>
+    class mode_tensor {
+
+    public:
+
+        static constexpr std::uint32_t version = 1;
+        static constexpr size_t alignment = 64;
+
+        //zero modes in memory
+        mode_tensor(const types::vector1d_t<T>& x, const types::vector1d_t<T>& y, const types::vector1d_t<T>& z, const size_t& nm) {
+            const auto header = _make_header(x, y, z, nm);
+            const auto block = std::make_shared<utils::tensor<char, 1>>(std::array<size_t, 1>{ _layout(header).back() });
+            _init(block, block->data(), block->size(), header, x, y, z);
+        }
+
+        //zero modes in a new file, everything written to them ends up in the file once the last view of it is gone
+        static mode_tensor create(const std::filesystem::path& path,
+                                  const types::vector1d_t<T>& x, const types::vector1d_t<T>& y, const types::vector1d_t<T>& z, const size_t& nm) {
+            const auto header = _make_header(x, y, z, nm);
+            const auto file = std::make_shared<utils::mapped_file>(path, _layout(header).back());
+
+            mode_tensor result;
+            result._init(file, file->data(), file->size(), header, x, y, z);
+            return result;
+        }
+
+        //modes of an existing file written with the same value types, changes to them never reach the file
+        static mode_tensor map(const std::filesystem::path& path) {
+            const auto file = std::make_shared<utils::mapped_file>(path);
+            const auto name = path.generic_string();
+
+            utils::dynamic_assert(file->size() >= sizeof(_header), "File ", name, " is too small to hold modes");
+            _header header;
+            std::memcpy(&header, file->data(), sizeof(header));
+
+            utils::dynamic_assert(std::memcmp(header.magic, _magic, sizeof(_magic)) == 0, "File ", name, " does not hold modes");
+            utils::dynamic_assert(header.version == version,
+                "Modes in ", name, " are of version ", header.version, ", but ", version, " is expected");
+            utils::dynamic_assert(header.value_size == sizeof(T) && bool(header.complex) == _impl::is_complex<V>::value,
+                "Modes in ", name, " are of a different precision or complexity");
+            utils::dynamic_assert(_layout(header).back() == file->size(), "File ", name, " is truncated");
+
+            mode_tensor result;
+            result._owner = file;
+            result._base = file->data();
+            return result;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _get_header().nm;
+        }
+
+        [[nodiscard]] auto x() const {
+            return _mesh(0, _get_header().nx);
+        }
+
+        [[nodiscard]] auto y() const {
+            return _mesh(1, _get_header().ny);
+        }
+
+        [[nodiscard]] auto z() const {
+            return _mesh(2, _get_header().nz);
+        }
+
+        [[nodiscard]] utils::tensor_view<V, 3> k() const {
+            const auto& header = _get_header();
+            return utils::tensor_view<V, 3>(_at<V>(_layout(header)[3]), { header.nm, header.nx, header.ny });
+        }
+
+        [[nodiscard]] utils::tensor_view<T, 4> phi() const {
+            const auto& header = _get_header();
+            return utils::tensor_view<T, 4>(_at<T>(_layout(header)[4]), { header.nm, header.nx, header.ny, header.nz });
+        }
+
+        //copies modes given as interpolated data, modal functions over other meshes are sampled at the nodes of this one
+        template<typename K, typename P>
+        void assign(const K& k_j, const P& phi_j) {
+            const auto x = this->x(), y = this->y(), z = this->z();
+            const auto nm = std::min({ size(), k_j.size(), phi_j.size() });
+            utils::dynamic_assert(k_j.template get<0>() == x && k_j.template get<1>() == y,
+                "Wavenumbers must be given over the same x and y as modes they are assigned to");
+
+            const auto same = phi_j.template get<0>() == x && phi_j.template get<1>() == y && phi_j.template get<2>() == z;
+            const auto k = this->k();
+            const auto phi = this->phi();
+            for (size_t j = 0; j < nm; ++j)
+                for (size_t i = 0; i < x.size(); ++i)
+                    for (size_t l = 0; l < y.size(); ++l) {
+                        k(j, i, l) = k_j[j].data()[i][l];
+                        const auto row = phi[j][i][l];
+                        if (same)
+                            std::copy_n(phi_j[j].data()[i][l].begin(), z.size(), row.begin());
+                        else
+                            for (size_t m = 0; m < z.size(); ++m)
+                                row[m] = phi_j[j].point(x[i], y[l], z[m]);
+                    }
+        }
+
+        //interpolators view the block and keep it alive, nothing is copied but the meshes
+        [[nodiscard]] auto interpolated() const {
+            using k_view = utils::shared_tensor_view<const V, 2>;
+            using phi_view = utils::shared_tensor_view<const T, 3>;
+
+            const auto k = this->k();
+            const auto phi = this->phi();
+
+            types::vector1d_t<k_view> k_j;
+            types::vector1d_t<phi_view> phi_j;
+            k_j.reserve(size());
+            phi_j.reserve(size());
+            for (size_t j = 0; j < size(); ++j) {
+                k_j.emplace_back(_owner, k[j].data(), utils::_impl::tail(k.shape()));
+                phi_j.emplace_back(_owner, phi[j].data(), utils::_impl::tail(phi.shape()));
+            }
+
+            return std::make_tuple(
+                utils::linear_interpolated_data_2d<T, V, k_view>(x(), y(), std::move(k_j)),
+                utils::linear_interpolated_data_3d<T, T, phi_view>(x(), y(), z(), std::move(phi_j))
+            );
+        }
+
+    private:
+
+        //native byte order
+        struct _header {
+
+            char magic[8];
+            std::uint32_t version, value_size, complex, reserved;
+            std::uint64_t nm, nx, ny, nz;
+
+        };
+
+        static constexpr char _magic[8] = { 'A', 'M', 'P', 'L', 'E', 'M', 'T', '\0' };
+
+        std::shared_ptr<const void> _owner;
+        char* _base = nullptr;
+
+        mode_tensor() = default;
+
+        static _header _make_header(const types::vector1d_t<T>& x, const types::vector1d_t<T>& y, const types::vector1d_t<T>& z, const size_t& nm) {
+            _header header{};
+            std::memcpy(header.magic, _magic, sizeof(_magic));
+            header.version = version;
+            header.value_size = sizeof(T);
+            header.complex = _impl::is_complex<V>::value;
+            header.nm = nm;
+            header.nx = x.size();
+            header.ny = y.size();
+            header.nz = z.size();
+            return header;
+        }
+
+        //block is zeroed, so only the header and meshes are written
+        void _init(std::shared_ptr<const void> owner, char* base, const size_t& size, const _header& header,
+                   const types::vector1d_t<T>& x, const types::vector1d_t<T>& y, const types::vector1d_t<T>& z) {
+            const auto layout = _layout(header);
+            utils::dynamic_assert(size == layout.back(), "Modes block is of a wrong size");
+
+            _owner = std::move(owner);
+            _base = base;
+            std::memcpy(_base, &header, sizeof(header));
+            std::copy(x.begin(), x.end(), _at<T>(layout[0]));
+            std::copy(y.begin(), y.end(), _at<T>(layout[1]));
+            std::copy(z.begin(), z.end(), _at<T>(layout[2]));
+        }
+
+        static size_t _align(const size_t& offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        //offsets of x, y, z, k and phi followed by the total size
+        static std::array<size_t, 6> _layout(const _header& header) {
+            std::array<size_t, 6> result{};
+            result[0] = _align(sizeof(_header));
+            result[1] = _align(result[0] + header.nx * sizeof(T));
+            result[2] = _align(result[1] + header.ny * sizeof(T));
+            result[3] = _align(result[2] + header.nz * sizeof(T));
+            result[4] = _align(result[3] + header.nm * header.nx * header.ny * sizeof(V));
+            result[5] = result[4] + header.nm * header.nx * header.ny * header.nz * sizeof(T);
+            return result;
+        }
+
+        [[nodiscard]] const _header& _get_header() const {
+            return *reinterpret_cast<const _header*>(_base);
+        }
+
+        template<typename U>
+        [[nodiscard]] U* _at(const size_t& offset) const {
+            return reinterpret_cast<U*>(_base + offset);
+        }
+
+        [[nodiscard]] types::vector1d_t<T> _mesh(const size_t& i, const size_t& n) const {
+            const auto data = _at<const T>(_layout(_get_header())[i]);
+            return types::vector1d_t<T>(data, data + n);
+        }
+
+    };
+
+}// namespace ample
@@ -1,15 +1,28 @@
 #pragma once
+#include <cmath>
+#include <array>
 #include <tuple>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <thread>
 #include <cstddef>
+#include <cstdint>
 #include <istream>
+#include <numeric>
+#include <optional>
+#include <unordered_map>
 #include <algorithm>
 #include <type_traits>
+#include "modes_cache.hpp"
+#include "mode_tensor.hpp"
 #include "normal_modes.h"
+#include "modal_problem.hpp"
 #include "utils/types.hpp"
 #include "utils/utils.hpp"
 #include "utils/assert.hpp"
+#include "utils/tensor.hpp"
 #include "utils/callback.hpp"
 #include "utils/interpolation.hpp"
 
@@ -20,10 +33,52 @@ namespace ample {
 
     namespace _impl {
 
+        //computed part of NormalModes
+        struct modes_column {
+
+            decltype(NormalModes::khs) khs;
+            decltype(NormalModes::mattenuation) mattenuation;
+            decltype(NormalModes::mfunctions_zr) mfunctions_zr;
+
+            modes_column() = default;
+
+            explicit modes_column(const NormalModes& n_m) :
+                khs(n_m.khs), mattenuation(n_m.mattenuation), mfunctions_zr(n_m.mfunctions_zr) {}
+
+            void assign_to(NormalModes& n_m) const {
+                n_m.khs = khs;
+                n_m.mattenuation = mattenuation;
+                n_m.mfunctions_zr = mfunctions_zr;
+            }
+
+        };
+
+        //inputs of the modal problem at a node that do not depend on frequency
+        struct modes_environment {
+
+            decltype(NormalModes::M_depths) depths;
+            decltype(NormalModes::M_c1s) c1s, c2s;
+            decltype(NormalModes::M_Ns_points) points;
+
+            void assign_to(NormalModes& n_m) const {
+                n_m.M_depths = depths;
+                n_m.M_c1s = c1s;
+                n_m.M_c2s = c2s;
+                n_m.M_Ns_points = points;
+            }
+
+        };
+
         template<typename T, typename V>
         struct modes_copier {
 
-            static void copy(const NormalModes& n_m, types::vector3d_t<V>& k_j, types::vector4d_t<T>& phi_j,
+            template<typename N>
+            static V value(const N& n_m, const size_t& k) {
+                return V(n_m.khs[k], n_m.mattenuation[k]);
+            }
+
+            template<typename N>
+            static void copy(N& n_m, types::vector3d_t<V>& k_j, types::vector4d_t<T>& phi_j,
                     const size_t& i, const size_t& j) {
                 for (size_t k = 0; k < std::min(n_m.khs.size(), k_j.size()); ++k) {
                     k_j[k][i][j] = V(n_m.khs[k], n_m.mattenuation[k]);
@@ -31,7 +86,8 @@ namespace ample {
                 }
             }
 
-            static void copy(const NormalModes& n_m, types::vector2d_t<V>& k_j, types::vector3d_t<T>& phi_j,
+            template<typename N>
+            static void copy(N& n_m, types::vector2d_t<V>& k_j, types::vector3d_t<T>& phi_j,
                              const size_t& i) {
                 for (size_t k = 0; k < std::min(n_m.khs.size(), k_j.size()); ++k) {
                     k_j[k][i] = V(n_m.khs[k], n_m.mattenuation[k]);
@@ -44,7 +100,13 @@ namespace ample {
         template<typename T>
         struct modes_copier<T, T> {
 
-            static void copy(const NormalModes& n_m, types::vector3d_t<T>& k_j, types::vector4d_t<T>& phi_j,
+            template<typename N>
+            static T value(const N& n_m, const size_t& k) {
+                return n_m.khs[k];
+            }
+
+            template<typename N>
+            static void copy(N& n_m, types::vector3d_t<T>& k_j, types::vector4d_t<T>& phi_j,
                     const size_t& i, const size_t& j) {
                 for (size_t k = 0; k < std::min(n_m.khs.size(), k_j.size()); ++k) {
                     k_j[k][i][j] = n_m.khs[k];
@@ -52,7 +114,8 @@ namespace ample {
                 }
             }
 
-            static void copy(const NormalModes& n_m, types::vector2d_t<T>& k_j, types::vector3d_t<T>& phi_j,
+            template<typename N>
+            static void copy(N& n_m, types::vector2d_t<T>& k_j, types::vector3d_t<T>& phi_j,
                              const size_t& i) {
                 for (size_t k = 0; k < std::min(n_m.khs.size(), k_j.size()); ++k) {
                     k_j[k][i] = n_m.khs[k];
@@ -79,7 +142,15 @@ namespace ample {
             _n_m.ordRich = static_cast<unsigned int>(_config.ord_rich());
             _n_m.f = _config.f();
             _n_m.M_betas = _config.betas();
-            _n_m.eigen_type = "alglib";
+            _n_m.eigen_type = _config.eigen_type();
+            utils::dynamic_assert(_n_m.eigen_type == "alglib" || _n_m.eigen_type == "native",
+                                  "Unknown eigen type \"", _n_m.eigen_type, '"');
+            utils::dynamic_assert(_n_m.eigen_type != "native" || _n_m.iModesSubset < 0,
+                                  "\"mode_subset\" is not supported by native eigen type");
+            //continuation refines modes of the native operator, so with any other eigen type a modal grid would mix
+            //modes of two discretizations and attenuation models wherever it falls back to a full solution
+            utils::dynamic_assert(_n_m.eigen_type == "native" || !_config.mode_continuation(),
+                                  "\"mode_continuation\" requires native eigen type");
 
             _n_m.M_depths.resize(_config.n_layers() + _config.bottom_layers().size());
             if (!config.additive_depth())
@@ -95,6 +166,9 @@ namespace ample {
             _n_m.M_rhos.insert(_n_m.M_rhos.end(), _config.bottom_rhos().begin(), _config.bottom_rhos().end());
 
             _n_m.M_Ns_points.resize(_n_m.M_depths.size());
+
+            if (!_config.modes_cache().empty())
+                _cache.emplace(_config.modes_cache());
         }
 
         modes(const config<T>& config, const types::vector1d_t<T>& z) : modes(config) {
@@ -117,16 +191,16 @@ namespace ample {
         template<typename C, typename = std::enable_if_t<std::is_invocable_v<C, const NormalModes&, const size_t&>>>
         void line(const T& x, const T& y0, const T& y1, const size_t& ny, C&& callback, const size_t& num_workers = 1, const size_t& c = -1) {
             const auto hy = (y1 - y0) / (ny - 1);
-            const auto depth = _config.bathymetry().line(x, y0, y1, ny);
+            const auto& depth = _begin_sweep({ x, x, T(1), y0, y1, T(ny) }, ny,
+                [&]() { return _config.bathymetry().line(x, y0, y1, ny); });
 
-            _compute(ny, num_workers, [&](const size_t i0, const size_t i1, NormalModes n_m) {
-                    auto y = y0 + hy * i0;
-                    for (size_t i = i0; i < i1; ++i, y += hy) {
-                        _point(n_m, x, y, depth[i], c);
-                        callback(std::as_const(n_m), std::as_const(i));
-                    }
+            _columns columns;
+            _compute(depth, num_workers, [&](const size_t& i, NormalModes& n_m) {
+                    _point(n_m, x, y0 + hy * i, depth[i], c, &columns, i);
+                    callback(std::as_const(n_m), i);
                 }
             );
+            _end_sweep();
 
         }
 
@@ -156,21 +230,23 @@ namespace ample {
 
         template<typename C, typename = std::enable_if_t<std::is_invocable_v<C, const NormalModes&, const size_t&>>>
         auto vector_line(const T& x, const T& y0, const T& y1, const size_t& ny, C&& callback, const size_t& num_workers = 1, const size_t& c = -1) {
-            size_t m = 0;
-            types::vector2d_t<V> k_j;
-            types::vector3d_t<T> phi_j;
-
-            std::mutex mutex;
+            types::vector1d_t<_impl::modes_column> nodes(ny);
             line(x, y0, y1, ny, 
                 utils::callbacks(
                     callback,
-                    [&, mm=_config.max_mode()](const NormalModes& n_m, const size_t& i) mutable {
-                        std::lock_guard<std::mutex> lock(mutex);
-                        _fill_data(n_m, k_j, phi_j, ny, i, mm, m);
-                    }
+                    [&nodes](const NormalModes& n_m, const size_t& i) { nodes[i] = _impl::modes_column(n_m); }
                 ), num_workers, c
             );
 
+            //nodes are completed in any order, so data is placed only afterwards into storage of the final size
+            const auto nm = _mode_count(nodes.begin(), nodes.end());
+            const auto nz = _n_m.zr.size();
+            types::vector2d_t<V> k_j(nm, types::vector1d_t<V>(ny, V(0)));
+            types::vector3d_t<T> phi_j(nm, types::vector2d_t<T>(ny));
+
+            _parallel(ny, num_workers, [&](const size_t& i) { _place(nodes[i], nm, nz, k_j, phi_j, i); });
+            _parallel(nm, num_workers, [&](const size_t& k) { _fill_missing(nodes.begin(), nodes.end(), k, k_j[k]); });
+
             return std::make_tuple(std::move(k_j), std::move(phi_j));
         }
 
@@ -225,21 +301,14 @@ namespace ample {
             const T& x0, const T& x1, const size_t& nx,
             const T& y0, const T& y1, const size_t& ny,
             C&& callback, const size_t& num_workers = 1, const size_t& c = -1) {
-            const auto hx = (x1 - x0) / (nx - 1);
-            const auto hy = (y1 - y0) / (ny - 1);
-            const auto depth = _config.bathymetry().field(x0, x1, nx, y0, y1, ny);
-
-            _compute(ny, num_workers, [&](const size_t j0, const size_t j1, NormalModes n_m) {
-                    auto x = x0;
-                    for (size_t i = 0; i < nx; ++i, x += hx) {
-                        auto y = y0 + j0 * hy;
-                        for (size_t j = j0; j < j1; ++j, y += hy) {
-                            _point(n_m, x, y, depth[i][j], c);
-                            callback(std::as_const(n_m), std::as_const(i), std::as_const(j));
-                        }
-                    }
-                }
-            );
+            const auto& depth = _begin_field(x0, x1, nx, y0, y1, ny);
+
+            types::vector1d_t<size_t> nodes(nx * ny);
+            std::iota(nodes.begin(), nodes.end(), size_t(0));
+
+            _columns columns;
+            _field(x0, x1, nx, y0, y1, ny, depth, nodes, columns, callback, num_workers, c);
+            _end_sweep();
         }
 
         template<typename C, typename = std::enable_if_t<std::is_invocable_v<C, const NormalModes&, const size_t&, const size_t&>>>
@@ -276,21 +345,22 @@ namespace ample {
             const T& x0, const T& x1, const size_t& nx,
             const T& y0, const T& y1, const size_t& ny,
             C&& callback, const size_t& num_workers = 1, const size_t& c = -1, const bool& smooth = false) {
-            types::vector3d_t<V> k_j;
-            types::vector4d_t<T> phi_j;
+            auto nodes = _field_nodes(x0, x1, nx, y0, y1, ny, callback, num_workers, c);
 
-            std::mutex mutex;
+            //nodes are completed in any order, so data is placed only afterwards into storage of the final size;
+            //every row is written by a single thread and rows are independent
+            const auto nm = _mode_count(nodes);
 
-            field(x0, x1, nx, y0, y1, ny,
-                utils::callbacks(
-                    callback,
-                    [&, m=size_t(0), mm=_config.max_mode()](const NormalModes& n_m, const size_t& i, const size_t& j) mutable {
-                        std::lock_guard<std::mutex> lock(mutex);
-                        m = j ? m : 0;
-                        _fill_data(n_m, k_j, phi_j, nx, ny, i, j, mm, m);
-                    }
-                ), num_workers, c
-            );
+            const auto nz = _n_m.zr.size();
+            types::vector3d_t<V> k_j(nm, types::vector2d_t<V>(nx, types::vector1d_t<V>(ny, V(0))));
+            types::vector4d_t<T> phi_j(nm, types::vector3d_t<T>(nx, types::vector2d_t<T>(ny)));
+
+            _parallel(nx, num_workers, [&](const size_t& i) {
+                for (size_t j = 0; j < ny; ++j)
+                    _place(nodes[i][j], nm, nz, k_j, phi_j, i, j);
+                for (size_t k = 0; k < nm; ++k)
+                    _fill_missing(nodes[i].begin(), nodes[i].end(), k, k_j[k][i]);
+            });
 
             if (smooth)
                 _smooth((y1 - y0) / (ny - 1), _config.border_width(), k_j, phi_j);
@@ -310,6 +380,28 @@ namespace ample {
             return vector_field(_config.mnx(), _config.mny(), callback, num_workers, c);
         }
 
+        //the same as vector_field, but modes are placed straight into a single contiguous block
+        template<typename C, typename = std::enable_if_t<std::is_invocable_v<C, const NormalModes&, const size_t&, const size_t&>>>
+        auto tensor_field(
+            const T& x0, const T& x1, const size_t& nx,
+            const T& y0, const T& y1, const size_t& ny,
+            C&& callback, const size_t& num_workers = 1, const size_t& c = -1) {
+            auto nodes = _field_nodes(x0, x1, nx, y0, y1, ny, callback, num_workers, c);
+
+            mode_tensor<T, V> result(utils::mesh_1d(x0, x1, nx), utils::mesh_1d(y0, y1, ny), _n_m.zr, _mode_count(nodes));
+            const auto k_j = result.k();
+            const auto phi_j = result.phi();
+
+            _parallel(nx, num_workers, [&](const size_t& i) {
+                for (size_t j = 0; j < ny; ++j)
+                    _place(nodes[i][j], k_j, phi_j, i, j);
+                for (size_t k = 0; k < k_j.size(); ++k)
+                    _fill_missing(nodes[i].begin(), nodes[i].end(), k, k_j[k][i]);
+            });
+
+            return result;
+        }
+
         auto interpolated_field(
             const T& x0, const T& x1, const size_t& nx,
             const T& y0, const T& y1, const size_t& ny,
@@ -332,14 +424,7 @@ namespace ample {
             const T& x0, const T& x1, const size_t& nx,
             const T& y0, const T& y1, const size_t& ny,
             C&& callback, const size_t& num_workers = 1, const size_t& c = -1) {
-            const auto x = utils::mesh_1d(x0, x1, nx);
-            const auto y = utils::mesh_1d(y0, y1, ny);
-            auto [k_j, phi_j] = vector_field(x0, x1, nx, y0, y1, ny, callback, num_workers, c);
-
-            return std::make_tuple(
-                utils::linear_interpolated_data_2d<T, V>(x, y, std::move(k_j)),
-                utils::linear_interpolated_data_3d<T, T>(x, y, _n_m.zr, std::move(phi_j))
-            );
+            return tensor_field(x0, x1, nx, y0, y1, ny, callback, num_workers, c).interpolated();
         }
 
         template<typename C, typename = std::enable_if_t<std::is_invocable_v<C, const NormalModes&, const size_t&, const size_t&>>>
@@ -359,31 +444,138 @@ namespace ample {
             _n_m.zr.assign(z.begin(), z.end());
         }
 
+        //modes computed next are of frequency f; a line or field over the same nodes as the previous one reuses
+        //its bathymetry and sound speed samples, and with "mode_continuation" its wavenumbers scaled by the ratio
+        //of frequencies are refined instead of solving every node from scratch, so frequencies are best swept in order
+        void frequency(const T& f) {
+            _n_m.f = f;
+        }
+
     private:
 
+        //nodes of the last line or field: their depths and environment, which do not depend on frequency,
+        //and wavenumbers of frequency f that are guesses for the next one; current is filled by the computation
+        //in progress, every node only by the thread computing it
+        struct _sweep_state {
+
+            types::vector1d_t<T> key, depth;
+            types::vector1d_t<_impl::modes_environment> environment;
+            types::vector1d_t<decltype(NormalModes::khs)> previous, current;
+            //set once current of a node is written, so that threads computing its neighbours may take it as guesses
+            std::unique_ptr<std::atomic<bool>[]> done;
+            size_t ny = 0, reach = 1;
+            T f = T(0);
+
+        };
+
+        //cell [i0, i1] x [j0, j1] of the adaptive modal grid in node indices
+        struct _cell {
+
+            size_t i0, i1, j0, j1;
+
+            [[nodiscard]] size_t area() const {
+                return (i1 - i0) * (j1 - j0);
+            }
+
+            [[nodiscard]] std::array<std::tuple<size_t, size_t>, 4> corners() const {
+                return { { { i0, j0 }, { i0, j1 }, { i1, j0 }, { i1, j1 } } };
+            }
+
+            //midpoints of sides and the centre, none if there are no nodes inside
+            [[nodiscard]] types::vector1d_t<std::tuple<size_t, size_t>> probes() const {
+                if (i1 - i0 < 2 && j1 - j0 < 2)
+                    return {};
+
+                const auto im = (i0 + i1) / 2, jm = (j0 + j1) / 2;
+                return { { im, j0 }, { im, j1 }, { i0, jm }, { i1, jm }, { im, jm } };
+            }
+
+            //halves along every side that has nodes inside
+            void split(types::vector1d_t<_cell>& cells) const {
+                const auto halves = [](const size_t& a, const size_t& b) {
+                    return b - a > 1 ?
+                        types::vector1d_t<std::tuple<size_t, size_t>>{ { a, (a + b) / 2 }, { (a + b) / 2, b } } :
+                        types::vector1d_t<std::tuple<size_t, size_t>>{ { a, b } };
+                };
+
+                for (const auto& [a0, a1] : halves(i0, i1))
+                    for (const auto& [b0, b1] : halves(j0, j1))
+                        cells.push_back({ a0, a1, b0, b1 });
+            }
+
+            //bilinear weights of corners (i0, j0), (i0, j1), (i1, j0) and (i1, j1) at node (i, j)
+            [[nodiscard]] std::array<T, 4> weights(const size_t& i, const size_t& j) const {
+                const auto tx = i1 > i0 ? T(i - i0) / T(i1 - i0) : T(0);
+                const auto ty = j1 > j0 ? T(j - j0) / T(j1 - j0) : T(0);
+                return { (1 - tx) * (1 - ty), (1 - tx) * ty, tx * (1 - ty), tx * ty };
+            }
+
+        };
+
         NormalModes _n_m;
         const config<T>& _config;
+        std::optional<modes_cache> _cache;
+        _sweep_state _sweep;
 
         static constexpr T eps = 1;
+        static constexpr T quantum = T(1e-3);
+        //nodes along x and y this far are taken as neighbours of a node in a regular grid
+        static constexpr size_t neighbour_reach = 3;
+
+        //modes of distinct water columns met during one line or field computation,
+        //nodes with equal quantized layer depths and sound speeds share a single eigenproblem
+        class _columns {
+
+        public:
+
+            bool load(const std::string& key, NormalModes& n_m) const {
+                std::lock_guard<std::mutex> lock(_mutex);
+                const auto it = _data.find(key);
+                if (it == _data.end())
+                    return false;
+
+                it->second.assign_to(n_m);
+                return true;
+            }
+
+            void store(const std::string& key, const NormalModes& n_m) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _data.try_emplace(key, n_m);
+            }
+
+        private:
+
+            mutable std::mutex _mutex;
+            std::unordered_map<std::string, _impl::modes_column> _data;
+
+        };
 
+        //nodes are taken one at a time through an atomic counter, deepest first as the eigenproblem grows with depth,
+        //so threads that are done with shallow nodes keep pulling work and the most expensive ones are not left for last
         template<typename C>
-        void _compute(const size_t& n, size_t num_workers, C&& callback) {
+        void _compute(const types::vector1d_t<T>& cost, size_t num_workers, C&& callback) {
+            const auto n = cost.size();
             num_workers = std::min(num_workers, n);
 
             if (num_workers <= 1) {
-                callback(0, n, _n_m);
+                for (size_t k = 0; k < n; ++k)
+                    callback(k, _n_m);
                 return;
             }
 
+            types::vector1d_t<size_t> order(n);
+            std::iota(order.begin(), order.end(), size_t(0));
+            std::stable_sort(order.begin(), order.end(), [&cost](const auto& a, const auto& b) { return cost[a] > cost[b]; });
+
+            std::atomic<size_t> next(0);
             types::vector1d_t<std::thread> workers;
             workers.reserve(num_workers);
 
-            const auto m = n / num_workers;
-
             for (size_t i = 0; i < num_workers; ++i)
-                workers.emplace_back(
-                        [&callback](const size_t& i, const size_t& j, NormalModes n_m) { callback(i, j, std::move(n_m)); },
-                        m * i, i == num_workers - 1 ? n : m * (i + 1), _n_m);
+                workers.emplace_back([&, n_m=_n_m]() mutable {
+                    for (auto k = next.fetch_add(1, std::memory_order_relaxed); k < n; k = next.fetch_add(1, std::memory_order_relaxed))
+                        callback(order[k], n_m);
+                });
 
             for (auto& it : workers)
                 it.join();
@@ -415,7 +607,71 @@ namespace ample {
             }
         }
 
-        void _point(NormalModes& n_m, const T& x, const T& y, const T& depth, const size_t& c = -1) {
+        //nodes are sampled anew only if they differ from the nodes of the previous line or field
+        template<typename D>
+        const types::vector1d_t<T>& _begin_sweep(types::vector1d_t<T> key, const size_t& ny, D&& depth) {
+            if (key != _sweep.key) {
+                _sweep = _sweep_state();
+                _sweep.key = std::move(key);
+                _sweep.depth = depth();
+
+                const auto n = _sweep.depth.size();
+                _sweep.environment.resize(n);
+                _sweep.previous.resize(n);
+            }
+
+            _sweep.current.assign(_sweep.depth.size(), {});
+            _sweep.done = std::make_unique<std::atomic<bool>[]>(_sweep.depth.size());
+            _sweep.ny = ny;
+            _sweep.reach = neighbour_reach;
+            return _sweep.depth;
+        }
+
+        void _end_sweep() {
+            std::swap(_sweep.previous, _sweep.current);
+            _sweep.current.clear();
+            _sweep.done.reset();
+            _sweep.f = T(_n_m.f);
+        }
+
+        //wavenumbers of node at the previous frequency scaled to the current one, as k is roughly proportional to f,
+        //otherwise wavenumbers of the closest node of this sweep that is already computed
+        decltype(NormalModes::khs) _sweep_guesses(const NormalModes& n_m, const size_t& node) const {
+            if (_sweep.f <= 0 || _sweep.f == T(n_m.f) || _sweep.previous[node].empty())
+                return _neighbour_guesses(node);
+
+            auto result = _sweep.previous[node];
+            if (n_m.nmod > 0 && result.size() > size_t(n_m.nmod))
+                result.resize(n_m.nmod);
+            for (auto& it : result)
+                it *= T(n_m.f) / _sweep.f;
+            return result;
+        }
+
+        //nodes are looked for along x and y at most reach nodes away, as the order of computation is not spatial,
+        //and the one of the closest depth is taken as its modes are the most alike
+        decltype(NormalModes::khs) _neighbour_guesses(const size_t& node) const {
+            const auto n = _sweep.current.size(), ny = _sweep.ny;
+            const auto i = node / ny, j = node % ny;
+
+            auto best = size_t(-1);
+            for (size_t d = 1; d <= _sweep.reach; ++d) {
+                const std::array<std::tuple<bool, size_t>, 4> around = { {
+                    { i >= d, node - d * ny }, { (i + d) * ny < n, node + d * ny }, { j >= d, node - d }, { j + d < ny, node + d }
+                } };
+
+                for (const auto& [inside, k] : around)
+                    if (inside && _sweep.done[k].load(std::memory_order_acquire) && !_sweep.current[k].empty() &&
+                        (best == size_t(-1) ||
+                            std::abs(_sweep.depth[k] - _sweep.depth[node]) < std::abs(_sweep.depth[best] - _sweep.depth[node])))
+                        best = k;
+            }
+
+            return best == size_t(-1) ? decltype(NormalModes::khs)() : _sweep.current[best];
+        }
+
+        void _point(NormalModes& n_m, const T& x, const T& y, const T& depth, const size_t& c = -1, _columns* columns = nullptr,
+                    const size_t& node = -1) {
             utils::dynamic_assert(!n_m.zr.empty(), "There must be at least one depth value");
 
             if (depth <= eps) {
@@ -427,6 +683,34 @@ namespace ample {
             n_m.nmod = static_cast<int>(c == -1 ? _config.n_modes() : c);
             n_m.alpha = M_PI / 180 * (n_m.nmod > 0);
 
+            //a sampled node always has layers
+            if (node == size_t(-1))
+                _sample(n_m, x, depth);
+            else if (!_sweep.environment[node].depths.empty())
+                _sweep.environment[node].assign_to(n_m);
+            else {
+                _sample(n_m, x, depth);
+                _sweep.environment[node] = { n_m.M_depths, n_m.M_c1s, n_m.M_c2s, n_m.M_Ns_points };
+            }
+
+            const auto key = columns ? _column_key(n_m) : std::string();
+            if (!columns || !columns->load(key, n_m)) {
+                if (!_config.mode_continuation())
+                    _solve(n_m);
+                else
+                    _solve(n_m, node != size_t(-1) ? _sweep_guesses(n_m, node) : decltype(NormalModes::khs)(n_m.khs));
+
+                if (columns)
+                    columns->store(key, n_m);
+            }
+
+            if (node != size_t(-1)) {
+                _sweep.current[node] = n_m.khs;
+                _sweep.done[node].store(true, std::memory_order_release);
+            }
+        }
+
+        void _sample(NormalModes& n_m, const T& x, const T& depth) const {
             auto buff = utils::mesh_1d(T(0), depth, _config.n_layers() + 1);
             std::copy(buff.begin() + 1, buff.end(), n_m.M_depths.begin());
 
@@ -441,11 +725,41 @@ namespace ample {
             n_m.M_Ns_points[0] = static_cast<unsigned>(std::round(n_m.ppm * n_m.M_depths[0]));
             for (size_t i = 1; i < n_m.M_depths.size(); ++i)
                 n_m.M_Ns_points[i] = static_cast<unsigned>(std::round(n_m.ppm * (n_m.M_depths[i] - n_m.M_depths[i - 1])));
+        }
+
+        //guesses are refined if there are any, a point without them or where they fail is solved from scratch
+        void _solve(NormalModes& n_m, const decltype(NormalModes::khs)& guesses = {}) const {
+            if (_cache && _cache->load(n_m, Complex))
+                return;
+
+            if (!_config.mode_continuation() || !continue_modes(n_m, guesses, Complex)) {
+                if (n_m.eigen_type == "native")
+                    solve_modes<T>(n_m, Complex);
+                else {
+                    n_m.compute_khs();
+                    n_m.compute_mfunctions_zr();
+                    if constexpr (Complex)
+                        n_m.compute_mattenuation();
+                }
+            }
+
+            if (_cache)
+                _cache->store(n_m, Complex);
+        }
 
-            n_m.compute_khs();
-            n_m.compute_mfunctions_zr();
-            if constexpr (Complex)
-                n_m.compute_mattenuation();
+        //the rest of inputs is the same for every node of a single computation
+        static std::string _column_key(const NormalModes& n_m) {
+            std::string result;
+            const auto append = [&result](const auto& value) {
+                result.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            };
+
+            append(n_m.nmod);
+            for (const auto& values : { &n_m.M_depths, &n_m.M_c1s, &n_m.M_c2s })
+                for (const auto& it : *values)
+                    append(std::int64_t(std::llround(it / quantum)));
+
+            return result;
         }
 
         void _point(const T& x, const T& y, const T& depth, const size_t& c = -1) {
@@ -456,36 +770,305 @@ namespace ample {
             _point(x, y, _config.bathymetry().point(x, y), c);
         }
 
-        static auto _fill_data(const NormalModes& n_m, types::vector3d_t<V>& k_j, types::vector4d_t<T>& phi_j,
-                const size_t& nx, const size_t& ny, const size_t& i, const size_t& j, const size_t& mm, size_t& m) {
-            const auto n = std::min(n_m.khs.size(), mm);
-            if (n > k_j.size()) {
-                k_j.resize(n, types::vector2d_t<V>(nx, types::vector1d_t<V>(ny, V(0))));
-                phi_j.resize(n, types::vector3d_t<T>(nx, types::vector2d_t<T>(ny, types::vector1d_t<T>(n_m.zr.size(), T(0)))));
+        template<typename It>
+        size_t _mode_count(It begin, It end) const {
+            size_t result = 0;
+            for (; begin != end; ++begin)
+                result = std::max(result, std::min(begin->khs.size(), _config.max_mode()));
+            return result;
+        }
+
+        const types::vector1d_t<T>& _begin_field(const T& x0, const T& x1, const size_t& nx, const T& y0, const T& y1, const size_t& ny) {
+            return _begin_sweep({ x0, x1, T(nx), y0, y1, T(ny) }, ny,
+                [&]() {
+                    types::vector1d_t<T> result;
+                    result.reserve(nx * ny);
+                    for (const auto& it : _config.bathymetry().field(x0, x1, nx, y0, y1, ny))
+                        result.insert(result.end(), it.begin(), it.end());
+                    return result;
+                }
+            );
+        }
+
+        //computes nodes given by their flat indices i * ny + j of the field
+        template<typename C>
+        void _field(
+            const T& x0, const T& x1, const size_t& nx,
+            const T& y0, const T& y1, const size_t& ny,
+            const types::vector1d_t<T>& depth, const types::vector1d_t<size_t>& nodes, _columns& columns,
+            C&& callback, const size_t& num_workers, const size_t& c) {
+            const auto hx = (x1 - x0) / (nx - 1);
+            const auto hy = (y1 - y0) / (ny - 1);
+
+            types::vector1d_t<T> cost(nodes.size());
+            for (size_t k = 0; k < nodes.size(); ++k)
+                cost[k] = depth[nodes[k]];
+
+            _compute(cost, num_workers, [&](const size_t& k, NormalModes& n_m) {
+                    const auto node = nodes[k];
+                    const auto i = node / ny, j = node % ny;
+                    _point(n_m, x0 + hx * i, y0 + hy * j, depth[node], c, &columns, node);
+                    callback(std::as_const(n_m), i, j);
+                }
+            );
+        }
+
+        template<typename C>
+        auto _field_nodes(
+            const T& x0, const T& x1, const size_t& nx,
+            const T& y0, const T& y1, const size_t& ny,
+            C&& callback, const size_t& num_workers, const size_t& c) {
+            if (_config.modes_tolerance() > 0)
+                return _adaptive_nodes(x0, x1, nx, y0, y1, ny, callback, num_workers, c);
+
+            types::vector2d_t<_impl::modes_column> nodes(nx, types::vector1d_t<_impl::modes_column>(ny));
+            field(x0, x1, nx, y0, y1, ny,
+                utils::callbacks(
+                    callback,
+                    [&nodes](const NormalModes& n_m, const size_t& i, const size_t& j) { nodes[i][j] = _impl::modes_column(n_m); }
+                ), num_workers, c
+            );
+            return nodes;
+        }
+
+        //modes are computed at corners of coarse cells first; a cell is split in four until wavenumbers computed at
+        //midpoints of its sides and at its centre are reproduced by bilinear interpolation of its corners within
+        //"modes_tolerance", and the remaining nodes of cells that are not split are interpolated from their corners
+        template<typename C>
+        auto _adaptive_nodes(
+            const T& x0, const T& x1, const size_t& nx,
+            const T& y0, const T& y1, const size_t& ny,
+            C&& callback, const size_t& num_workers, const size_t& c) {
+            const auto step = _config.modes_step();
+            utils::dynamic_assert(step > 0, "Adaptive modes step must be positive");
+
+            const auto& depth = _begin_field(x0, x1, nx, y0, y1, ny);
+            //computed nodes are at most a step apart
+            _sweep.reach = std::max(step, neighbour_reach);
+
+            types::vector2d_t<_impl::modes_column> nodes(nx, types::vector1d_t<_impl::modes_column>(ny));
+            types::vector1d_t<char> computed(nx * ny, 0);
+            _columns columns;
+
+            const auto compute = [&](types::vector1d_t<size_t> indices) {
+                std::sort(indices.begin(), indices.end());
+                indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+                indices.erase(std::remove_if(indices.begin(), indices.end(), [&](const auto& k) { return computed[k]; }), indices.end());
+
+                _field(x0, x1, nx, y0, y1, ny, depth, indices, columns,
+                    utils::callbacks(
+                        callback,
+                        [&nodes](const NormalModes& n_m, const size_t& i, const size_t& j) { nodes[i][j] = _impl::modes_column(n_m); }
+                    ), num_workers, c
+                );
+
+                for (const auto& k : indices)
+                    computed[k] = 1;
+            };
+
+            types::vector1d_t<_cell> cells, leaves;
+            for (const auto& [i0, i1] : _intervals(nx, step))
+                for (const auto& [j0, j1] : _intervals(ny, step))
+                    cells.push_back({ i0, i1, j0, j1 });
+
+            types::vector1d_t<size_t> corners;
+            for (const auto& it : cells)
+                for (const auto& [i, j] : it.corners())
+                    corners.push_back(i * ny + j);
+            compute(std::move(corners));
+
+            while (!cells.empty()) {
+                types::vector1d_t<size_t> probes;
+                for (const auto& it : cells)
+                    for (const auto& [i, j] : it.probes())
+                        probes.push_back(i * ny + j);
+                compute(std::move(probes));
+
+                types::vector1d_t<_cell> next;
+                for (const auto& it : cells)
+                    if (it.probes().empty() || _interpolable(nodes, it))
+                        leaves.push_back(it);
+                    else
+                        it.split(next);
+                cells = std::move(next);
             }
-            _impl::modes_copier<T, V>::copy(n_m, k_j, phi_j, i, j);
-            for (size_t k = m; k < n; ++k)
-                for (size_t l = 0; l < j; ++l)
-                    k_j[k][i][l] = k_j[k][i][j];
-            for (size_t k = n; k < m; ++k)
-                k_j[k][i][j] = k_j[k][i][j - 1];
-            m = std::max(n, m);
-        }
-
-        static auto _fill_data(const NormalModes& n_m, types::vector2d_t<V>& k_j, types::vector3d_t<T>& phi_j,
-                               const size_t& ny, const size_t& i, const size_t& mm, size_t& m) {
-            const auto n = std::min(n_m.khs.size(), mm);
-            if (n > k_j.size()) {
-                k_j.resize(n, types::vector1d_t<V>(ny, V(0)));
-                phi_j.resize(n, types::vector2d_t<T>(ny, types::vector1d_t<T>(n_m.zr.size(), T(0))));
+
+            //a node on a side shared by cells of different sizes is interpolated in the smallest of them
+            std::stable_sort(leaves.begin(), leaves.end(), [](const auto& a, const auto& b) { return a.area() > b.area(); });
+            types::vector1d_t<size_t> owner(nx * ny, size_t(-1));
+            for (size_t l = 0; l < leaves.size(); ++l)
+                for (auto i = leaves[l].i0; i <= leaves[l].i1; ++i)
+                    for (auto j = leaves[l].j0; j <= leaves[l].j1; ++j)
+                        if (!computed[i * ny + j])
+                            owner[i * ny + j] = l;
+
+            _parallel(nx, num_workers, [&](const size_t& i) {
+                auto n_m = _n_m;
+                for (size_t j = 0; j < ny; ++j)
+                    if (owner[i * ny + j] != size_t(-1)) {
+                        nodes[i][j] = _interpolate(nodes, leaves[owner[i * ny + j]], i, j);
+                        nodes[i][j].assign_to(n_m);
+                        callback(std::as_const(n_m), i, j);
+                    }
+            });
+
+            //only computed nodes keep their wavenumbers, the rest start from a computed neighbour at the next frequency
+            _end_sweep();
+            return nodes;
+        }
+
+        //[i0, i1] pairs of node indices splitting n nodes into intervals of step nodes
+        static types::vector1d_t<std::tuple<size_t, size_t>> _intervals(const size_t& n, const size_t& step) {
+            if (n < 2)
+                return { { 0, 0 } };
+
+            types::vector1d_t<std::tuple<size_t, size_t>> result;
+            for (size_t i = 0; i + 1 < n; i += step)
+                result.emplace_back(i, std::min(i + step, n - 1));
+            return result;
+        }
+
+        //a cell is interpolable if its corners and probes have the same number of modes
+        //and every wavenumber of a probe is reproduced by its corners within the tolerance
+        bool _interpolable(const types::vector2d_t<_impl::modes_column>& nodes, const _cell& cell) const {
+            const auto tolerance = _config.modes_tolerance();
+            const auto count = [&](const size_t& i, const size_t& j) { return std::min(nodes[i][j].khs.size(), _config.max_mode()); };
+
+            const auto nm = count(cell.i0, cell.j0);
+            for (const auto& [i, j] : cell.corners())
+                if (count(i, j) != nm)
+                    return false;
+
+            for (const auto& [i, j] : cell.probes()) {
+                if (count(i, j) != nm)
+                    return false;
+
+                const auto [a, b, c, d] = cell.weights(i, j);
+                for (size_t k = 0; k < nm; ++k) {
+                    const auto value = _impl::modes_copier<T, V>::value(nodes[i][j], k);
+                    const auto approximation =
+                        a * _impl::modes_copier<T, V>::value(nodes[cell.i0][cell.j0], k) +
+                        b * _impl::modes_copier<T, V>::value(nodes[cell.i0][cell.j1], k) +
+                        c * _impl::modes_copier<T, V>::value(nodes[cell.i1][cell.j0], k) +
+                        d * _impl::modes_copier<T, V>::value(nodes[cell.i1][cell.j1], k);
+                    if (std::abs(value - approximation) > tolerance * std::abs(value))
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        static _impl::modes_column _interpolate(const types::vector2d_t<_impl::modes_column>& nodes, const _cell& cell,
+                                                const size_t& i, const size_t& j) {
+            const auto& n00 = nodes[cell.i0][cell.j0];
+            const auto& n01 = nodes[cell.i0][cell.j1];
+            const auto& n10 = nodes[cell.i1][cell.j0];
+            const auto& n11 = nodes[cell.i1][cell.j1];
+            const auto [a, b, c, d] = cell.weights(i, j);
+
+            const auto blend = [&](const auto& v00, const auto& v01, const auto& v10, const auto& v11, auto& result) {
+                result.resize(std::min({ v00.size(), v01.size(), v10.size(), v11.size() }));
+                for (size_t k = 0; k < result.size(); ++k)
+                    result[k] = a * v00[k] + b * v01[k] + c * v10[k] + d * v11[k];
+            };
+
+            _impl::modes_column result;
+            blend(n00.khs, n01.khs, n10.khs, n11.khs, result.khs);
+            blend(n00.mattenuation, n01.mattenuation, n10.mattenuation, n11.mattenuation, result.mattenuation);
+
+            //signs of modal functions are arbitrary, so they are matched to the first corner before blending
+            result.mfunctions_zr.resize(result.khs.size());
+            for (size_t k = 0; k < result.khs.size(); ++k) {
+                const auto& phi = n00.mfunctions_zr[k];
+                const auto sign = [&](const _impl::modes_column& n_m) {
+                    return std::inner_product(phi.begin(), phi.end(), n_m.mfunctions_zr[k].begin(), T(0)) < 0 ? T(-1) : T(1);
+                };
+
+                const auto [s01, s10, s11] = std::make_tuple(sign(n01), sign(n10), sign(n11));
+                auto& values = result.mfunctions_zr[k];
+                values.resize(phi.size());
+                for (size_t l = 0; l < values.size(); ++l)
+                    values[l] = a * phi[l] + b * s01 * n01.mfunctions_zr[k][l] + c * s10 * n10.mfunctions_zr[k][l] + d * s11 * n11.mfunctions_zr[k][l];
             }
+
+            return result;
+        }
+
+        size_t _mode_count(const types::vector2d_t<_impl::modes_column>& nodes) const {
+            size_t result = 0;
+            for (const auto& it : nodes)
+                result = std::max(result, _mode_count(it.begin(), it.end()));
+            return result;
+        }
+
+        //modal functions of modes a node does not have are zero
+        static void _place(_impl::modes_column& n_m, const size_t& nm, const size_t& nz,
+                           types::vector3d_t<V>& k_j, types::vector4d_t<T>& phi_j, const size_t& i, const size_t& j) {
+            _impl::modes_copier<T, V>::copy(n_m, k_j, phi_j, i, j);
+            for (size_t k = std::min(n_m.khs.size(), nm); k < nm; ++k)
+                phi_j[k][i][j].assign(nz, T(0));
+        }
+
+        static void _place(_impl::modes_column& n_m, const size_t& nm, const size_t& nz,
+                           types::vector2d_t<V>& k_j, types::vector3d_t<T>& phi_j, const size_t& i) {
             _impl::modes_copier<T, V>::copy(n_m, k_j, phi_j, i);
-            for (size_t k = m; k < n; ++k)
-                for (size_t l = 0; l < i; ++l)
-                    k_j[k][l] = k_j[k][i];
-            for (size_t k = n; k < m; ++k)
-                k_j[k][i] = k_j[k][i - 1];
-            m = std::max(n, m);
+            for (size_t k = std::min(n_m.khs.size(), nm); k < nm; ++k)
+                phi_j[k][i].assign(nz, T(0));
+        }
+
+        //storage is zeroed, so modes a node does not have are left as they are
+        static void _place(const _impl::modes_column& n_m, const utils::tensor_view<V, 3>& k_j, const utils::tensor_view<T, 4>& phi_j,
+                           const size_t& i, const size_t& j) {
+            for (size_t k = 0; k < std::min(n_m.khs.size(), k_j.size()); ++k) {
+                k_j(k, i, j) = _impl::modes_copier<T, V>::value(n_m, k);
+                const auto& function = n_m.mfunctions_zr[k];
+                std::copy_n(function.begin(), std::min(function.size(), phi_j.shape(3)), phi_j[k][i][j].begin());
+            }
+        }
+
+        //wavenumber k of nodes that do not have it is taken from the closest previous node that has it,
+        //or from the first one that has it for nodes before it; a row without mode k keeps zeros
+        template<typename It, typename R>
+        static void _fill_missing(It begin, It end, const size_t& k, R&& k_j) {
+            const auto n = size_t(end - begin);
+            const auto has = [&](const size_t& j) { return begin[j].khs.size() > k; };
+
+            size_t first = 0;
+            while (first < n && !has(first))
+                ++first;
+            if (first == n)
+                return;
+
+            std::fill(k_j.begin(), k_j.begin() + first, k_j[first]);
+            for (size_t j = first + 1; j < n; ++j)
+                if (!has(j))
+                    k_j[j] = k_j[j - 1];
+        }
+
+        //calls callback(k) for every k < n, indices are handed out through an atomic counter
+        template<typename C>
+        static void _parallel(const size_t& n, size_t num_workers, C&& callback) {
+            num_workers = std::min(num_workers, n);
+
+            if (num_workers <= 1) {
+                for (size_t k = 0; k < n; ++k)
+                    callback(k);
+                return;
+            }
+
+            std::atomic<size_t> next(0);
+            types::vector1d_t<std::thread> workers;
+            workers.reserve(num_workers);
+
+            for (size_t i = 0; i < num_workers; ++i)
+                workers.emplace_back([&]() {
+                    for (auto k = next.fetch_add(1, std::memory_order_relaxed); k < n; k = next.fetch_add(1, std::memory_order_relaxed))
+                        callback(k);
+                });
+
+            for (auto& it : workers)
+                it.join();
         }
 
     };
@@ -0,0 +1,182 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <exception>
+#include <filesystem>
+#include <type_traits>
+#include "normal_modes.h"
+
+namespace ample {
+
+    //normal modes stored on disk under a hash of everything they are computed from;
+    //every record starts with the hashed inputs themselves, so a hash collision is treated as a miss
+    class modes_cache {
+
+    public:
+
+        explicit modes_cache(std::filesystem::path path) : _path(std::move(path)) {
+            std::filesystem::create_directories(_path);
+        }
+
+        //fills wavenumbers, attenuation and modal functions of n_m if its inputs are found
+        bool load(NormalModes& n_m, const bool& attenuation) const {
+            const auto key = _key(n_m, attenuation);
+            std::ifstream file(_filename(key), std::ios_base::binary);
+            if (!file)
+                return false;
+
+            std::string stored;
+            decltype(n_m.khs) khs;
+            decltype(n_m.mattenuation) mattenuation;
+            decltype(n_m.mfunctions_zr) mfunctions_zr;
+            try {
+                if (!_read(file, stored) || stored != key ||
+                    !_read(file, khs) || !_read(file, mattenuation) || !_read(file, mfunctions_zr))
+                    return false;
+            }
+            catch (const std::exception&) {
+                return false; // damaged record with nonsensical sizes
+            }
+
+            n_m.khs = std::move(khs);
+            n_m.mattenuation = std::move(mattenuation);
+            n_m.mfunctions_zr = std::move(mfunctions_zr);
+            return true;
+        }
+
+        //records are written to a temporary file and renamed, so concurrent writers never expose a partial record
+        void store(const NormalModes& n_m, const bool& attenuation) const {
+            const auto key = _key(n_m, attenuation);
+            const auto filename = _filename(key);
+
+            std::ostringstream suffix;
+            suffix << '.' << std::this_thread::get_id() << '.' << std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+            auto temp = filename;
+            temp += suffix.str();
+
+            std::error_code error;
+            {
+                std::ofstream file(temp, std::ios_base::binary);
+                _write(file, key);
+                _write(file, n_m.khs);
+                _write(file, attenuation ? n_m.mattenuation : decltype(n_m.mattenuation)());
+                _write(file, n_m.mfunctions_zr);
+                if (!file) {
+                    file.close();
+                    std::filesystem::remove(temp, error);
+                    return;
+                }
+            }
+
+            std::filesystem::rename(temp, filename, error);
+            if (error)
+                std::filesystem::remove(temp, error);
+        }
+
+        [[nodiscard]] const auto& path() const {
+            return _path;
+        }
+
+    private:
+
+        static constexpr std::uint32_t _version = 1;
+
+        const std::filesystem::path _path;
+
+        static std::string _key(const NormalModes& n_m, const bool& attenuation) {
+            std::ostringstream stream(std::ios_base::binary);
+            _write(stream, _version);
+            _write(stream, n_m.M_depths);
+            _write(stream, n_m.M_c1s);
+            _write(stream, n_m.M_c2s);
+            _write(stream, n_m.M_rhos);
+            _write(stream, n_m.M_betas);
+            _write(stream, n_m.M_Ns_points);
+            _write(stream, n_m.zr);
+            _write(stream, n_m.ppm);
+            _write(stream, n_m.ordRich);
+            _write(stream, n_m.f);
+            _write(stream, n_m.nmod);
+            _write(stream, n_m.alpha);
+            _write(stream, n_m.iModesSubset);
+            _write(stream, n_m.eigen_type);
+            _write(stream, attenuation);
+            return stream.str();
+        }
+
+        //fnv-1a
+        static std::uint64_t _hash(const std::string& data) {
+            std::uint64_t result = 14695981039346656037ull;
+            for (const auto& it : data) {
+                result ^= static_cast<unsigned char>(it);
+                result *= 1099511628211ull;
+            }
+            return result;
+        }
+
+        [[nodiscard]] std::filesystem::path _filename(const std::string& key) const {
+            std::ostringstream name;
+            name << std::hex << std::setw(16) << std::setfill('0') << _hash(key) << ".bin";
+            return _path / name.str();
+        }
+
+        template<typename T>
+        static void _write(std::ostream& stream, const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be stored");
+            stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        static void _write(std::ostream& stream, const std::string& value) {
+            _write(stream, std::uint64_t(value.size()));
+            stream.write(value.data(), value.size());
+        }
+
+        template<typename T>
+        static void _write(std::ostream& stream, const std::vector<T>& value) {
+            _write(stream, std::uint64_t(value.size()));
+            if constexpr (std::is_trivially_copyable_v<T>)
+                stream.write(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(T));
+            else
+                for (const auto& it : value)
+                    _write(stream, it);
+        }
+
+        template<typename T>
+        static bool _read(std::istream& stream, T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be stored");
+            return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+        static bool _read(std::istream& stream, std::string& value) {
+            std::uint64_t n;
+            if (!_read(stream, n))
+                return false;
+            value.resize(n);
+            return bool(stream.read(value.data(), n));
+        }
+
+        template<typename T>
+        static bool _read(std::istream& stream, std::vector<T>& value) {
+            std::uint64_t n;
+            if (!_read(stream, n))
+                return false;
+            value.resize(n);
+            if constexpr (std::is_trivially_copyable_v<T>)
+                return bool(stream.read(reinterpret_cast<char*>(value.data()), n * sizeof(T)));
+            else {
+                for (auto& it : value)
+                    if (!_read(stream, it))
+                        return false;
+                return true;
+            }
+        }
+
+    };
+
+}// namespace ample
@@ -0,0 +1,235 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <cstddef>
+#include <exception>
+#include <algorithm>
+#include <condition_variable>
+#include "modes.hpp"
+#include "utils/types.hpp"
+#include "utils/utils.hpp"
+#include "utils/assert.hpp"
+#include "utils/callback.hpp"
+#include "utils/interpolation.hpp"
+
+namespace ample {
+
+    //modes of the field computed on a background thread slab by slab while the solution marches; a slab holds
+    //nodes + 1 consecutive rows of the modal grid, so neighbouring slabs share a row that is computed only once;
+    //up to window slabs are kept from the one the slowest mode is in, slabs every mode has passed are dropped,
+    //and a slab beyond the window is still computed when asked for, so modes running ahead never deadlock
+    //waiting for modes behind them; it is passed to solver::solve in place of k_j and phi_j
+    template<typename T, typename V = T>
+    class modes_stream {
+
+    public:
+
+        static constexpr size_t window = 3;
+
+        modes_stream(const config<T>& config, const size_t& nm, const size_t& nodes, const size_t& num_workers = 1) :
+            _nm(nm), _num_workers(num_workers), _modes(config, utils::mesh_1d(config.z0(), config.z1(), config.mnz())),
+            _x(utils::mesh_1d(config.x0(), config.x1(), config.mnx())),
+            _y(utils::mesh_1d(config.y0(), config.y1(), config.mny())),
+            _z(utils::mesh_1d(config.z0(), config.z1(), config.mnz())) {
+            utils::dynamic_assert(nodes > 0, "Slab must have at least one node");
+            _nodes = std::min(nodes, std::max(_x.size(), size_t(2)) - 1);
+            _ns = std::max(size_t(1), (_x.size() - 1 + _nodes - 1) / _nodes);
+            _position.resize(_nm, 0);
+            _users.resize(_ns, 0);
+            _users[0] = _nm;
+            _producer = std::thread([this]() { _produce(); });
+        }
+
+        modes_stream(const modes_stream&) = delete;
+        modes_stream& operator=(const modes_stream&) = delete;
+
+        ~modes_stream() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wanted.notify_all();
+            _producer.join();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _nm;
+        }
+
+        //mode j as interpolated data of the solver: line gives wavenumbers, field gives modal functions
+        [[nodiscard]] auto operator[](const size_t& j) const {
+            return _mode(*this, j);
+        }
+
+        [[nodiscard]] size_t slabs() const {
+            return _ns;
+        }
+
+    private:
+
+        struct _slab {
+
+            _slab(types::vector1d_t<T> x, const types::vector1d_t<T>& y, const types::vector1d_t<T>& z,
+                  types::vector3d_t<V>&& k_j, types::vector4d_t<T>&& phi_j) :
+                k(x, y, std::move(k_j)), phi(std::move(x), y, z, std::move(phi_j)) {}
+
+            //interpolators refer to the meshes stored inside, so a slab never moves once created
+            utils::linear_interpolated_data_2d<T, V> k;
+            utils::linear_interpolated_data_3d<T, T> phi;
+
+        };
+
+        class _mode {
+
+        public:
+
+            _mode(const modes_stream& owner, const size_t& j) : _owner(owner), _j(j) {}
+
+            //wavenumbers are read once per range step of every mode, so they also advance the mode
+            template<typename... Args>
+            void line(const T& x, Args&&... args) const {
+                _owner._acquire(x, _j, true)->k[_j].line(x, std::forward<Args>(args)...);
+            }
+
+            template<typename... Args>
+            void field(const T& x, Args&&... args) const {
+                _owner._acquire(x, _j, false)->phi[_j].field(x, std::forward<Args>(args)...);
+            }
+
+        private:
+
+            const modes_stream& _owner;
+            const size_t _j;
+
+        };
+
+        const size_t _nm, _num_workers;
+        size_t _nodes, _ns;
+        modes<T, V> _modes;
+        const types::vector1d_t<T> _x, _y, _z;
+
+        //everything below is shared with the producer and guarded by _mutex
+        mutable std::mutex _mutex;
+        mutable std::condition_variable _ready, _wanted;
+        mutable std::deque<std::shared_ptr<const _slab>> _slabs;
+        mutable types::vector1d_t<size_t> _position, _users;
+        mutable size_t _first = 0, _demand = 0;
+        std::exception_ptr _error;
+        bool _stop = false;
+
+        std::thread _producer;
+
+        [[nodiscard]] size_t _index(const T& x) const {
+            if (_x.size() < 2)
+                return 0;
+            const auto i = size_t(std::max(T(0), (x - _x.front()) / (_x[1] - _x.front())));
+            return std::min(i / _nodes, _ns - 1);
+        }
+
+        std::shared_ptr<const _slab> _acquire(const T& x, const size_t& j, const bool& advance) const {
+            const auto s = _index(x);
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (advance && s > _position[j]) {
+                --_users[_position[j]];
+                ++_users[_position[j] = s];
+                _release();
+            }
+
+            if (s >= _first + _slabs.size() && s > _demand) {
+                _demand = s;
+                _wanted.notify_one();
+            }
+
+            _ready.wait(lock, [&]() { return _error || s < _first + _slabs.size(); });
+            if (_error)
+                std::rethrow_exception(_error);
+            return _slabs[s - _first];
+        }
+
+        //modes never move back, so the oldest slab is no longer needed once it has no modes in it
+        void _release() const {
+            const auto first = _first;
+            while (!_slabs.empty() && _first < _ns && _users[_first] == 0) {
+                _slabs.pop_front();
+                ++_first;
+            }
+            if (_first != first)
+                _wanted.notify_one();
+        }
+
+        void _produce() {
+            types::vector2d_t<V> k_last;
+            types::vector3d_t<T> phi_last;
+
+            try {
+                for (size_t s = 0; s < _ns; ++s) {
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _wanted.wait(lock, [&]() { return _stop || s < _first + window || s <= _demand; });
+                        if (_stop)
+                            return;
+                    }
+
+                    auto slab = _compute(s, k_last, phi_last);
+
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _slabs.push_back(std::move(slab));
+                    }
+                    _ready.notify_all();
+                }
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _error = std::current_exception();
+                }
+                _ready.notify_all();
+            }
+        }
+
+        //rows [r0, r1] of slab s, row r0 is taken from the previous slab; modes missing in a slab are zero,
+        //the same as in a row of the whole field where they are missing
+        std::shared_ptr<const _slab> _compute(const size_t& s, types::vector2d_t<V>& k_last, types::vector3d_t<T>& phi_last) {
+            const auto r0 = std::min(s * _nodes, _x.size() - 1);
+            const auto r1 = std::min(r0 + _nodes, _x.size() - 1);
+            const auto c0 = s > 0 ? r0 + 1 : r0;
+            const auto rows = r1 - r0 + 1;
+            const auto ny = _y.size(), nz = _z.size();
+
+            types::vector3d_t<V> k_j(_nm, types::vector2d_t<V>(rows, types::vector1d_t<V>(ny, V(0))));
+            types::vector4d_t<T> phi_j(_nm, types::vector3d_t<T>(rows, types::vector2d_t<T>(ny, types::vector1d_t<T>(nz, T(0)))));
+
+            if (s > 0)
+                for (size_t j = 0; j < _nm; ++j) {
+                    k_j[j][0] = std::move(k_last[j]);
+                    phi_j[j][0] = std::move(phi_last[j]);
+                }
+
+            if (c0 <= r1) {
+                auto [k, phi] = _modes.vector_field(_x[c0], _x[r1], r1 - c0 + 1, _y.front(), _y.back(), ny,
+                                                    utils::nothing_callback(), _num_workers, _nm);
+                for (size_t j = 0; j < std::min(_nm, k.size()); ++j)
+                    for (size_t i = c0; i <= r1; ++i) {
+                        k_j[j][i - r0] = std::move(k[j][i - c0]);
+                        phi_j[j][i - r0] = std::move(phi[j][i - c0]);
+                    }
+            }
+
+            k_last.resize(_nm);
+            phi_last.resize(_nm);
+            for (size_t j = 0; j < _nm; ++j) {
+                k_last[j] = k_j[j].back();
+                phi_last[j] = phi_j[j].back();
+            }
+
+            return std::make_shared<const _slab>(types::vector1d_t<T>(_x.begin() + r0, _x.begin() + r1 + 1), _y, _z,
+                                                 std::move(k_j), std::move(phi_j));
+        }
+
+    };
+
+}// namespace ample
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <complex>
 #include <cstddef>
 #include <algorithm>
 #include <type_traits>
@@ -188,14 +189,15 @@ namespace ample::rays {
         }
     }
 
-    template<typename Arg, typename Val>
+    //wavenumbers that are complex or held in other storage are copied into real ones first
+    template<typename Arg, typename Val, typename D>
     auto compute(
             const Arg& x0, const Arg& y0,
             const Arg& l1, const size_t& nl,
             const Arg& a0, const Arg& a1, const size_t& na,
-            const utils::linear_interpolated_data_2d<Arg, Val>& k_j,
+            const utils::linear_interpolated_data_2d<Arg, Val, D>& k_j,
             const bool& show_progress = false) {
-        if constexpr (!std::is_same_v<Arg, Val>) {
+        if constexpr (!std::is_same_v<Arg, Val> || !std::is_same_v<D, types::vector2d_t<Val>>) {
             const auto& x = k_j.template get<0>();
             const auto& y = k_j.template get<1>();
 
@@ -204,7 +206,7 @@ namespace ample::rays {
                 const auto& k_j_data = k_j[i].data();
                 for (size_t j = 0; j < data[i].size(); ++j)
                     std::transform(k_j_data[j].begin(), k_j_data[j].end(), data[i][j].begin(),
-                        [](const auto& value) { return value.real(); }
+                        [](const auto& value) { return std::real(value); }
                     );
             }
 
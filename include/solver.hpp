@@ -1,15 +1,23 @@
 #pragma once
 #include <cmath>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <cstddef>
 #include <complex>
+#include <utility>
 #include <algorithm>
+#include <type_traits>
 #include "config.hpp"
 #include "utils/types.hpp"
 #include "utils/utils.hpp"
 #include "utils/assert.hpp"
+#include "utils/tensor.hpp"
+#include "utils/barrier.hpp"
 #include "coefficients.hpp"
+#include "utils/schedule.hpp"
+#include "utils/projection.hpp"
+#include "utils/tridiagonal.hpp"
 #include "boundary_conditions.hpp"
 #include "utils/interpolation.hpp"
 
@@ -22,7 +30,23 @@ namespace ample {
     
     using namespace std::complex_literals;
 
-    template<typename BC, typename Arg = typename BC::arg_t, typename Val = typename BC::val_t>
+    template<typename T, typename V>
+    class modes_stream;
+
+    namespace _impl {
+
+        //wavenumbers given by linear interpolators over modal grids are linear in x between nodes of the grid
+        template<typename I>
+        struct is_linear_in_x : std::false_type {};
+
+        template<typename T, typename V, typename D>
+        struct is_linear_in_x<utils::interpolators::linear_interpolator_2d<T, V, D>> : std::true_type {};
+
+    }// namespace _impl
+
+    //pade coefficients, bands and their factorizations are computed in Val,
+    //modal amplitudes are marched and projected onto the field in Mar
+    template<typename BC, typename Arg = typename BC::arg_t, typename Val = typename BC::val_t, typename Mar = Val>
     class solver {
 
     public:
@@ -49,100 +73,140 @@ namespace ample {
                    const utils::linear_interpolated_data_1d<Arg, VL>& k_int,
                    const utils::linear_interpolated_data_2d<Arg, Arg>& phi_int,
                    CL&& callback,
+                   const utils::output_schedule& schedule = utils::output_schedule(),
                    const size_t num_workers = 1,
                    const size_t buff_size = 100) const {
             const auto nm = k0.size();
             utils::dynamic_assert(k_int.size() == nm && phi_int.size() == nm,
                 "Inputs k0(", nm, "), k_int(", k_int.size(), "), phi_int(", phi_int.size(), ") must have the same size");
 
-            types::vector1d_t<Val> a0(nm);
+            types::vector1d_t<Val> p0(nm);
             types::vector2d_t<VL>  kk(nm);
-            types::vector2d_t<Val> aa(nm), bb(nm);
-            types::vector3d_t<Arg> ph(nm);
+            types::vector2d_t<Val> pa(nm), bb(nm);
+            utils::tensor<Mrg, 3> ph({ nm, _ny, _nz });
             for (size_t j = 0; j < nm; ++j) {
                 kk[j] = k_int[j].line(_y0, _y1, _ny);
-                ph[j] = phi_int[j].field(_y0, _y1, _ny, _z0, _z1, _nz);
-                std::tie(a0[j], aa[j], bb[j]) = _coefficients.get(im * k0[j] * _hx);
+                const auto field = phi_int[j].field(_y0, _y1, _ny, _z0, _z1, _nz);
+                for (size_t y = 0; y < _ny; ++y)
+                    std::copy(field[y].begin(), field[y].end(), ph[j][y].begin());
+                std::tie(p0[j], pa[j], bb[j]) = _coefficients.get(im * k0[j] * _hx);
             }
 
+            const auto a0 = _cast(p0);
+            const auto aa = _weights(pa);
+
             const auto nw = _boundary_conditions.width();
             const auto nc = _coefficients.nc();
 
             auto band_builder = _boundary_conditions.get_band_builder(k0, bb, _y0, _y1, _ny);
             const auto [ac, bc, cc] = band_builder.coefficients();
             const auto ny = band_builder.ny();
+            const auto ld = band_builder.ld();
             band_builder.update(kk);
 
-            types::vector2d_t<Val> bv(_ny, types::vector1d_t<Val>(_nz, Val(0)));
-
-            auto cv = init.make(band_builder.y0(), band_builder.y1(), ny, k0.size());
-
-            for (size_t j = 0; j < nm; ++j) {
-                const auto exp = std::exp(im * k0[j] * _x0);
-                for (size_t y = 0, i = nw; y < _ny; ++y, ++i)
-                    for (size_t z = 0; z < _nz; ++z)
-                        bv[y][z] += ph[j][y][z] * cv[j][i] * exp;
-            }
+            utils::tensor<Mar, 2> bv({ _ny, _nz }, ze);
 
-            callback(_x0, bv);
+            auto cv = _amplitudes(init.make(band_builder.y0(), band_builder.y1(), ny, nm), ny);
 
-            auto solve_func = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1, auto&& call) {
-                types::vector2d_t<Val> ov(_ny, types::vector1d_t<Val>(_nz)),
-                                       nv( nc, types::vector1d_t<Val>( ny));
+            if (schedule.contains(0)) {
+                for (size_t j = 0; j < nm; ++j) {
+                    const auto exp = Mar(std::exp(im * k0[j] * _x0));
+                    for (size_t y = 0, i = nw; y < _ny; ++y, ++i)
+                        for (size_t z = 0; z < _nz; ++z)
+                            bv(y, z) += ph(j, y, z) * cv(i, j) * exp;
+                }
 
-                auto x = _x0 + _hx;
-                auto solver = _get_thomas_solver(ny);
+                callback(_x0, bv.view());
+            }
 
-                for (size_t _ = 1; _ < _nx; ++_) {
-                    for (size_t y = 0; y < _ny; ++y)
-                        ov[y].assign(_nz, ze);
+            //each chunk of modes advances by one range step per call and may be resumed on any worker
+            auto make_chunk = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1) {
+                const auto nb = (j1 - j0) * nc;
 
-                    for (size_t j = j0; j < j1; ++j) {
-                        nv.assign(nc, cv[j]);
-                        for (auto& it : nv)
-                            it.front() = it.back() = ze;
+                auto solver = utils::batched_thomas_solver<Mar, Val>(ny, nb);
+                solver.factorize(ac.data() + j0 * nc, bc.data() + j0 * nc, cc.data() + j0 * nc, ld);
 
-                        cv[j].front() = cv[j].back() = ze;
-                        for (size_t y = 1; y < ny - 1; ++y)
-                            cv[j][y] *= a0[j];
+                return [&, j0, j1, s=size_t(1), x=_x0 + _hx,
+                        cv=_columns(cv, j0, j1), nv=utils::tensor<Mar, 2>({ ny, _tile(ny, j1 - j0, nc, num_workers) * nc }),
+                        ov=utils::tensor<Mar, 2>({ _ny, _nz }),
+                        phase=_phases<VL>(k0, j0, j1, _x0 + _hx, _hx), sc=types::vector1d_t<Mar>(j1 - j0),
+                        solver=std::move(solver)](auto&& call) mutable {
+                    _march(solver, a0, aa, nc, j0, j1, cv, nv);
 
-                        for (size_t i = 0; i < nc; ++i) {
-                            solver(ac[j][i], bc[j][i], cc[j][i], nv[i]);
-                            std::transform(cv[j].begin(), cv[j].end(), nv[i].begin(), cv[j].begin(),
-                                           [&c=aa[j][i]](const auto& a, const auto& b) { return a + c * b; });
-                        }
-
-                        for (size_t i = 0, y = nw; i < _ny; ++i, ++y) {
-                            const auto exp = cv[j][y] * std::exp(im * k0[j] * x);
-                            for (size_t z = 0; z < _nz; ++z)
-                                ov[i][z] += ph[j][i][z] * exp;
-                        }
+                    if (schedule.contains(s)) {
+                        _project(cv, phase, ph, sc, j0, j1, nw, 0, _ny, ov.view());
+                        call(x, ov.view());
                     }
 
-                    call(x, ov);
+                    phase.advance();
                     x += _hx;
-                }
+                    ++s;
+                };
             };
 
-            _compute(solve_func, callback, nm, num_workers, buff_size);
+            //threads of a team share modes [j0, j1) and split rows of their systems
+            auto make_team = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1, const size_t np) {
+                return [&, &ac=ac, &bc=bc, &cc=cc, j0, j1, team=std::make_shared<_team>(ny, (j1 - j0) * nc, np, _ny, _nz, _columns(cv, j0, j1))]
+                        (const size_t p, auto&& call) {
+                    for (size_t parity = 0; parity < 2; ++parity)
+                        team->solver.factorize(p, ac.data() + j0 * nc, bc.data() + j0 * nc, cc.data() + j0 * nc, ld, parity);
+
+                    _run_team(*team, p, j0, j1, k0, a0, aa, nc, nw, ph, schedule,
+                              [](auto&&...) {}, std::forward<decltype(call)>(call));
+                };
+            };
+
+            _compute(make_chunk, make_team, callback, schedule, nm, num_workers, buff_size);
+        }
+
+        //modes may be held in any storage the interpolators view, e.g. a mode_tensor
+        template<typename IN, typename CL, typename VL, typename KD, typename PD>
+        void solve(const IN& init,
+                   const types::vector1d_t<VL>& k0,
+                   const utils::linear_interpolated_data_2d<Arg, VL, KD>& k_int,
+                   const utils::linear_interpolated_data_3d<Arg, Arg, PD>& phi_int,
+                   CL&& callback,
+                   const utils::output_schedule& schedule = utils::output_schedule(),
+                   const size_t num_workers = 1,
+                   const size_t buff_size = 100) const {
+            _solve_field(init, k0, k_int, phi_int, std::forward<CL>(callback), schedule, num_workers, buff_size);
         }
 
+        //modes are read from the slabs of the stream as the solution reaches them
         template<typename IN, typename CL, typename VL>
         void solve(const IN& init,
                    const types::vector1d_t<VL>& k0,
-                   const utils::linear_interpolated_data_2d<Arg, VL>& k_int,
-                   const utils::linear_interpolated_data_3d<Arg, Arg>& phi_int,
+                   const modes_stream<Arg, VL>& modes,
                    CL&& callback,
+                   const utils::output_schedule& schedule = utils::output_schedule(),
                    const size_t num_workers = 1,
                    const size_t buff_size = 100) const {
+            _solve_field(init, k0, modes, modes, std::forward<CL>(callback), schedule, num_workers, buff_size);
+        }
+
+    private:
+
+        //k_int[j].line(x, y0, y1, out) and phi_int[j].field(x, y0, y1, z0, z1, out) are all that is used of modes
+        template<typename IN, typename CL, typename VL, typename KI, typename PI>
+        void _solve_field(const IN& init,
+                          const types::vector1d_t<VL>& k0,
+                          const KI& k_int,
+                          const PI& phi_int,
+                          CL&& callback,
+                          const utils::output_schedule& schedule,
+                          const size_t num_workers,
+                          const size_t buff_size) const {
             const auto nm = k0.size();
             utils::dynamic_assert(k_int.size() == nm && phi_int.size() == nm,
                 "Inputs k0(", nm, "), k_int(", k_int.size(), "), phi_int(", phi_int.size(), ") must have the same size");
 
-            types::vector1d_t<Val> a0(nm);
-            types::vector2d_t<Val> aa(nm), bb(nm);
+            types::vector1d_t<Val> p0(nm);
+            types::vector2d_t<Val> pa(nm), bb(nm);
             for (size_t j = 0; j < nm; ++j)
-                std::tie(a0[j], aa[j], bb[j]) = _coefficients.get(im * k0[j] * _hx);
+                std::tie(p0[j], pa[j], bb[j]) = _coefficients.get(im * k0[j] * _hx);
+
+            const auto a0 = _cast(p0);
+            const auto aa = _weights(pa);
 
             const auto nw = _boundary_conditions.width();
             const auto nc = _coefficients.nc();
@@ -150,166 +214,575 @@ namespace ample {
             auto band_builder = _boundary_conditions.get_band_builder(k0, bb, _y0, _y1, _ny);
             const auto [ac, bc, cc] = band_builder.coefficients();
             const auto ny = band_builder.ny();
+            const auto ld = band_builder.ld();
 
-            types::vector2d_t<Arg> ip(_ny, types::vector1d_t<Arg>(_nz));
-            types::vector2d_t<Val> bv(_ny, types::vector1d_t<Val>(_nz, Val(0)));
-
-            auto cv = init.make(band_builder.y0(), band_builder.y1(), ny, k0.size());
+            utils::tensor<Mar, 2> bv({ _ny, _nz }, ze);
+            utils::tensor<Mrg, 3> ph({ nm, _ny, _nz });
 
-            for (size_t j = 0; j < nm; ++j) {
-                const auto exp = std::exp(im * k0[j] * _x0);
+            auto cv = _amplitudes(init.make(band_builder.y0(), band_builder.y1(), ny, nm), ny);
 
-                phi_int[j].field(_x0, _y0, _y1, _z0, _z1, ip);
-                for (size_t y = 0, i = nw; y < _ny; ++y, ++i)
-                    for (size_t z = 0; z < _nz; ++z)
-                        bv[y][z] += ip[y][z] * cv[j][i] * exp;
-            }
+            if (schedule.contains(0)) {
+                for (size_t j = 0; j < nm; ++j) {
+                    const auto exp = Mar(std::exp(im * k0[j] * _x0));
 
-            callback(_x0, bv);
+                    auto ip = ph[j];
+                    phi_int[j].field(_x0, _y0, _y1, _z0, _z1, ip);
+                    for (size_t y = 0, i = nw; y < _ny; ++y, ++i)
+                        for (size_t z = 0; z < _nz; ++z)
+                            bv(y, z) += ip(y, z) * cv(i, j) * exp;
+                }
 
-            types::vector2d_t<VL>  kk(nm, types::vector1d_t<VL> (_ny));
-            types::vector3d_t<Arg> ph(nm, types::vector2d_t<Arg>(_ny, types::vector1d_t<Arg>(_nz)));
+                callback(_x0, bv.view());
+            }
 
-            auto solve_func = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1, auto&& call) {
-                types::vector2d_t<Val> ov(_ny, types::vector1d_t<Val>(_nz)),
-                                       nv(nc, types::vector1d_t<Val>( ny));
+            _wavenumbers<KI, VL> kk(k_int, nm, _y0, _y1, _ny);
+
+            //each chunk of modes advances by one range step per call and may be resumed on any worker
+            auto make_chunk = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1) {
+                const auto nb = (j1 - j0) * nc;
+
+                return [&, &ac=ac, &bc=bc, &cc=cc, j0, j1, s=size_t(1), x=_x0 + _hx,
+                        cv=_columns(cv, j0, j1), nv=utils::tensor<Mar, 2>({ ny, _tile(ny, j1 - j0, nc, num_workers) * nc }),
+                        ov=utils::tensor<Mar, 2>({ _ny, _nz }),
+                        phase=_phases<VL>(k0, j0, j1, _x0 + _hx, _hx), sc=types::vector1d_t<Mar>(j1 - j0),
+                        solver=utils::batched_thomas_solver<Mar, Val>(ny, nb)](auto&& call) mutable {
+                    const auto output = schedule.contains(s);
+                    kk.at(x, j0, j1);
+                    if (output)
+                        for (size_t j = j0; j < j1; ++j) {
+                            auto field = ph[j];
+                            phi_int[j].field(x, _y0, _y1, _z0, _z1, field);
+                        }
 
-                auto x = _x0 + _hx;
-                auto solver = _get_thomas_solver(ny);
+                    //bands of modes whose wavenumbers have not changed since the last step are factorized already
+                    if (kk.update(band_builder, j0, j1, 0, ny))
+                        solver.factorize(ac.data() + j0 * nc, bc.data() + j0 * nc, cc.data() + j0 * nc, ld);
 
-                for (size_t _ = 1; _ < _nx; ++_) {
-                    for (size_t y = 0; y < _ny; ++y)
-                        ov[y].assign(_nz, ze);
+                    _march(solver, a0, aa, nc, j0, j1, cv, nv);
 
-                    for (size_t j = j0; j < j1; ++j) {
-                        k_int[j].line(x, _y0, _y1, kk[j]);
-                        phi_int[j].field(x, _y0, _y1, _z0, _z1, ph[j]);
+                    if (output) {
+                        _project(cv, phase, ph, sc, j0, j1, nw, 0, _ny, ov.view());
+                        call(x, ov.view());
                     }
 
-                    band_builder.update(kk, j0, j1);
-
-                    for (size_t j = j0; j < j1; ++j) {
-                        nv.assign(nc, cv[j]);
-                        for (auto& it : nv)
-                            it.front() = it.back() = ze;
-
-                        cv[j].front() = cv[j].back() = ze;
-                        for (size_t y = 1; y < ny - 1; ++y)
-                            cv[j][y] *= a0[j];
-
-                        for (size_t i = 0; i < nc; ++i) {
-                            solver(ac[j][i], bc[j][i], cc[j][i], nv[i]);
-                            std::transform(cv[j].begin(), cv[j].end(), nv[i].begin(), cv[j].begin(),
-                                           [&c=aa[j][i]](const auto& a, const auto& b) { return a + c * b; });
-                        }
-
-                        for (size_t i = 0, y = nw; i < _ny; ++i, ++y) {
-                            const auto exp = cv[j][y] * std::exp(im * k0[j] * x);
-                            for (size_t z = 0; z < _nz; ++z)
-                                ov[i][z] += ph[j][i][z] * exp;
-                        }
-                    }
-
-                    call(x, ov);
+                    phase.advance();
                     x += _hx;
-                }
+                    ++s;
+                };
+            };
+
+            //threads of a team share modes [j0, j1) and split rows of their systems,
+            //each thread updates bands and mode functions of its own rows only
+            auto make_team = [&, &ac=ac, &bc=bc, &cc=cc](const size_t j0, const size_t j1, const size_t np) {
+                return [&, &ac=ac, &bc=bc, &cc=cc, j0, j1, team=std::make_shared<_team>(ny, (j1 - j0) * nc, np, _ny, _nz, _columns(cv, j0, j1))]
+                        (const size_t p, auto&& call) {
+                    const auto hy = _ny > 1 ? (_y1 - _y0) / (_ny - 1) : Arg(0);
+                    _wavenumbers<KI, VL> kp(k_int, nm, _y0, _y1, _ny);
+
+                    const auto update = [&](const size_t& r0, const size_t& r1, const size_t& i0, const size_t& i1,
+                                            const Arg& x, const bool& output, const size_t& parity) {
+                        kp.at(x, j0, j1);
+                        if (output && i1 > i0)
+                            for (size_t j = j0; j < j1; ++j) {
+                                auto field = utils::tensor_view<Mrg, 2>(ph[j][i0].data(), { i1 - i0, _nz });
+                                phi_int[j].field(x, _y0 + i0 * hy, _y0 + (i1 - 1) * hy, _z0, _z1, field);
+                            }
+
+                        kp.update(band_builder, j0, j1, r0, r1);
+                        team->solver.factorize(p, ac.data() + j0 * nc, bc.data() + j0 * nc, cc.data() + j0 * nc, ld, parity);
+                    };
+
+                    _run_team(*team, p, j0, j1, k0, a0, aa, nc, nw, ph, schedule, update, std::forward<decltype(call)>(call));
+                };
             };
 
-            _compute(solve_func, callback, nm, num_workers, buff_size);
+            _compute(make_chunk, make_team, callback, schedule, nm, num_workers, buff_size);
         }
-        
 
-    private:
+        //mode functions are stored in the real type of Mar, so projection is done without conversions
+        using Mrg = typename Mar::value_type;
 
         static constexpr auto im = Val(0, 1);
-        static constexpr auto ze = Val(0);
+        static constexpr auto ze = Mar(0);
         static constexpr auto on = Arg(1);
         static constexpr auto tw = Arg(2);
 
+        static constexpr size_t _max_order = 16;
+        static constexpr size_t _tile_bytes = size_t(1) << 25;
+        static constexpr size_t _block = 16;
+        static constexpr size_t _chunks_per_worker = 2;
+        static constexpr size_t _min_rows = 8;
+
         BC _boundary_conditions;
         const size_t _nx{}, _ny{}, _nz{};
         coefficients<Val> _coefficients;
         const Arg _hx, _x0, _y0, _y1, _z0, _z1;
 
-        static auto _get_thomas_solver(const size_t ny) {
-            return [e=types::vector1d_t<Val>(ny), ny](
-                    const types::vector1d_t<Val>& a,
-                    const types::vector1d_t<Val>& b,
-                    const types::vector1d_t<Val>& c,
-                          types::vector1d_t<Val>& d) mutable {
-                e[0] = c[0] / b[0];
-                d[0] /= b[0];
-                for (size_t i = 1; i < ny - 1; ++i) {
-                    const auto w = b[i] - a[i] * e[i - 1];
-                    e[i] = c[i] / w;
-                    d[i] = (d[i] - a[i] * d[i - 1]) / w;
+        //exp(i k0 x) for modes [j0, j1) advanced by one range step at a time,
+        //the value is recomputed exactly every period steps to bound the accumulated rounding error
+        template<typename VL>
+        class _phases {
+
+        public:
+
+            static constexpr size_t period = 64;
+
+            _phases(const types::vector1d_t<VL>& k0, const size_t& j0, const size_t& j1, const Arg& x0, const Arg& hx) :
+                _j0(j0), _j1(j1), _x0(x0), _hx(hx), _k0(k0), _value(k0.size()), _step(k0.size()) {
+                for (size_t j = j0; j < j1; ++j)
+                    _step[j] = std::exp(im * k0[j] * hx);
+                _anchor();
+            }
+
+            const Val& operator[](const size_t& j) const {
+                return _value[j];
+            }
+
+            void advance() {
+                if (++_s % period == 0) {
+                    _anchor();
+                    return;
                 }
-                d.back() = (d.back() - a.back() * d[ny - 2]) / (b.back() - a.back() * e[ny - 2]);
-                for (size_t i = ny - 1; i > 0; --i)
-                    d[i - 1] -= e[i - 1] * d[i];
-            };
+
+                for (size_t j = _j0; j < _j1; ++j)
+                    _value[j] *= _step[j];
+            }
+
+        private:
+
+            size_t _s = 0;
+            const size_t _j0, _j1;
+            const Arg _x0, _hx;
+            const types::vector1d_t<VL>& _k0;
+            types::vector1d_t<Val> _value, _step;
+
+            void _anchor() {
+                const auto x = _x0 + _s * _hx;
+                for (size_t j = _j0; j < _j1; ++j)
+                    _value[j] = std::exp(im * _k0[j] * x);
+            }
+
+        };
+
+        //wavenumbers of modes at range x that bands are updated with; modes linear in x are read only at the two
+        //nodes of their grid around x, once per crossed node, and bands are blended from these rows in between,
+        //any other modes are read at every x
+        template<typename KI, typename VL>
+        class _wavenumbers {
+
+        public:
+
+            _wavenumbers(const KI& k_int, const size_t& nm, const Arg& y0, const Arg& y1, const size_t& ny) :
+                _k_int(k_int), _y0(y0), _y1(y1), _ka(nm, types::vector1d_t<VL>(ny)),
+                _kb(_blend ? nm : 0, types::vector1d_t<VL>(ny)), _t(nm, Arg(0)), _cells(nm, _none) {}
+
+            void at(const Arg& x, const size_t& j0, const size_t& j1) {
+                for (size_t j = j0; j < j1; ++j)
+                    if constexpr (_blend)
+                        _bracket(j, x);
+                    else
+                        _k_int[j].line(x, _y0, _y1, _ka[j]);
+            }
+
+            template<typename BB>
+            bool update(BB& band_builder, const size_t& j0, const size_t& j1, const size_t& r0, const size_t& r1) const {
+                if constexpr (_blend)
+                    return band_builder.update(_ka, _kb, _t, j0, j1, r0, r1);
+                else
+                    return band_builder.update(_ka, j0, j1, r0, r1);
+            }
+
+        private:
+
+            static constexpr auto _blend = _impl::is_linear_in_x<std::decay_t<decltype(std::declval<const KI&>()[0])>>::value;
+            static constexpr auto _none = size_t(-1);
+
+            const KI& _k_int;
+            const Arg _y0, _y1;
+            types::vector2d_t<VL> _ka, _kb;
+            types::vector1d_t<Arg> _t;
+            types::vector1d_t<size_t> _cells;
+
+            //x is clamped to the grid the same way interpolation does; rows of mode j are read again only when
+            //x leaves its cell, and the far row becomes the near one when x moves to the next cell
+            void _bracket(const size_t& j, const Arg& x) {
+                const auto& xs = _k_int[j].x();
+                const auto n = xs.size();
+                const auto i = size_t(std::upper_bound(xs.begin(), xs.end(), x) - xs.begin());
+                const auto c = std::clamp(i, size_t(1), std::max(n - 1, size_t(1))) - 1;
+                const auto d = std::min(c + 1, n - 1);
+
+                if (c != _cells[j]) {
+                    if (_cells[j] != _none && c == _cells[j] + 1)
+                        std::swap(_ka[j], _kb[j]);
+                    else
+                        _k_int[j].line(xs[c], _y0, _y1, _ka[j]);
+                    _k_int[j].line(xs[d], _y0, _y1, _kb[j]);
+                    _cells[j] = c;
+                }
+
+                _t[j] = d > c ? std::clamp((x - xs[c]) / (xs[d] - xs[c]), Arg(0), Arg(1)) : Arg(0);
+            }
+
+        };
+
+        static auto _cast(const types::vector1d_t<Val>& values) {
+            return types::vector1d_t<Mar>(values.begin(), values.end());
+        }
+
+        //weights of pade terms of all modes stored as [mode][term], the same way right-hand sides are
+        static auto _weights(const types::vector2d_t<Val>& values) {
+            types::vector1d_t<Mar> result;
+            for (const auto& it : values)
+                result.insert(result.end(), it.begin(), it.end());
+            return result;
+        }
+
+        //calls kernel with std::integral_constant<size_t, nc> for orders up to _max_order, so loops over pade terms
+        //have a constant trip count and are unrolled, or with std::integral_constant<size_t, 0> for any other order
+        template<typename K>
+        static void _dispatch(const size_t& nc, K&& kernel) {
+            _dispatch(nc, kernel, std::make_index_sequence<_max_order>());
+        }
+
+        template<typename K, size_t... N>
+        static void _dispatch(const size_t& nc, K& kernel, std::index_sequence<N...>) {
+            if (!((nc == N + 1 && (kernel(std::integral_constant<size_t, N + 1>()), true)) || ...))
+                kernel(std::integral_constant<size_t, 0>());
+        }
+
+        //modal amplitudes are stored as [y][mode], so all modes of a row are contiguous
+        static auto _amplitudes(const types::vector2d_t<Val>& values, const size_t& ny) {
+            utils::tensor<Mar, 2> result({ ny, values.size() });
+            for (size_t j = 0; j < values.size(); ++j)
+                for (size_t y = 0; y < ny; ++y)
+                    result(y, j) = Mar(values[j][y]);
+            return result;
+        }
+
+        //amplitudes of modes [j0, j1) only; every chunk marches its own copy, so workers never write to the same
+        //cache line of a row, which they would with a single [y][mode] tensor shared by all chunks
+        static auto _columns(const utils::tensor<Mar, 2>& cv, const size_t& j0, const size_t& j1) {
+            utils::tensor<Mar, 2> result({ cv.size(), j1 - j0 });
+            for (size_t y = 0; y < cv.size(); ++y)
+                std::copy(cv[y].data() + j0, cv[y].data() + j1, result[y].data());
+            return result;
+        }
+
+        //right-hand sides of rows [r0, r1) for all pade terms of modes [j0, j1), nv holds only these rows
+        //and cv only columns of these modes
+        static void _prepare(const types::vector1d_t<Mar>& a0, const size_t& nc, const size_t& j0, const size_t& j1,
+                             utils::tensor<Mar, 2>& cv, utils::tensor<Mar, 2>& nv, const size_t& r0, const size_t& r1) {
+            _dispatch(nc, [&](auto order) { _prepare_kernel<decltype(order)::value>(a0, nc, j0, j1, cv, nv, r0, r1); });
+        }
+
+        //NC is the number of pade terms, 0 if it is only known at run time
+        template<size_t NC>
+        static void _prepare_kernel(const types::vector1d_t<Mar>& a0, const size_t& order, const size_t& j0, const size_t& j1,
+                                    utils::tensor<Mar, 2>& cv, utils::tensor<Mar, 2>& nv, const size_t& r0, const size_t& r1) {
+            const auto nc = NC > 0 ? NC : order;
+            const auto ny = cv.size();
+
+            for (size_t y = r0; y < r1; ++y) {
+                const auto c = cv[y].data();
+                const auto n = nv[y - r0].data();
+
+                if (y == 0 || y == ny - 1) {
+                    std::fill(c, c + (j1 - j0), ze);
+                    nv[y - r0].fill(ze);
+                    continue;
+                }
+
+                for (size_t j = j0, k = 0; j < j1; ++j) {
+                    for (size_t i = 0; i < nc; ++i, ++k)
+                        n[k] = c[j - j0];
+                    c[j - j0] *= a0[j];
+                }
+            }
+        }
+
+        static void _accumulate(const types::vector1d_t<Mar>& aa, const size_t& nc, const size_t& j0, const size_t& j1,
+                                utils::tensor<Mar, 2>& cv, const utils::tensor<Mar, 2>& nv, const size_t& r0, const size_t& r1) {
+            _dispatch(nc, [&](auto order) { _accumulate_kernel<decltype(order)::value>(aa, nc, j0, j1, cv, nv, r0, r1); });
+        }
+
+        //terms of a mode are summed first, weights of a mode are loaded once per row and stay in registers
+        template<size_t NC>
+        static void _accumulate_kernel(const types::vector1d_t<Mar>& aa, const size_t& order, const size_t& j0, const size_t& j1,
+                                       utils::tensor<Mar, 2>& cv, const utils::tensor<Mar, 2>& nv, const size_t& r0, const size_t& r1) {
+            const auto nc = NC > 0 ? NC : order;
+            const auto w = aa.data() + j0 * nc;
+
+            for (size_t y = r0; y < r1; ++y) {
+                const auto c = cv[y].data();
+                const auto n = nv[y - r0].data();
+                for (size_t j = j0, k = 0; j < j1; ++j, k += nc) {
+                    auto sum = ze;
+                    for (size_t i = 0; i < nc; ++i)
+                        sum += w[k + i] * n[k + i];
+                    c[j - j0] += sum;
+                }
+            }
         }
 
-        static bool _all(const types::vector1d_t<bool>& values) {
-            return std::all_of(values.begin(), values.end(), [](const auto& v) { return v; });
+        //modes a chunk marches at once; the last level cache is shared by workers, which march a chunk each,
+        //so right-hand sides of all pade terms of a tile fit in their share of _tile_bytes; never narrower than one mode
+        static size_t _tile(const size_t& ny, const size_t& nm, const size_t& nc, const size_t& num_workers) {
+            const auto bytes = _tile_bytes / std::max(num_workers, size_t(1));
+            return std::clamp(bytes / (ny * nc * sizeof(Mar)), size_t(1), std::max(nm, size_t(1)));
         }
 
-        template<typename SF, typename CL>
-        void _compute(const SF& solve_func, CL&& callback, const size_t mc, size_t num_workers, const size_t buff_size) const {
-            num_workers = std::min(mc + 1, num_workers);
+        //one range step of all pade terms for modes [j0, j1) using factorized bands; modes are marched by tiles of nv,
+        //rows of a tile are prepared within the forward sweep and accumulated within the backward one, so a step
+        //makes two passes over a tile instead of four passes over right-hand sides of all modes
+        static void _march(const utils::batched_thomas_solver<Mar, Val>& solver,
+                           const types::vector1d_t<Mar>& a0, const types::vector1d_t<Mar>& aa,
+                           const size_t& nc, const size_t& j0, const size_t& j1,
+                           utils::tensor<Mar, 2>& cv, utils::tensor<Mar, 2>& nv) {
+            _dispatch(nc, [&](auto order) { _march_kernel<decltype(order)::value>(solver, a0, aa, nc, j0, j1, cv, nv); });
+        }
+
+        template<size_t NC>
+        static void _march_kernel(const utils::batched_thomas_solver<Mar, Val>& solver,
+                                  const types::vector1d_t<Mar>& a0, const types::vector1d_t<Mar>& aa,
+                                  const size_t& order, const size_t& j0, const size_t& j1,
+                                  utils::tensor<Mar, 2>& cv, utils::tensor<Mar, 2>& nv) {
+            const auto nc = NC > 0 ? NC : order;
+            const auto ny = cv.size();
+            const auto ld = nv.shape(1);
+            const auto tile = ld / nc;
+
+            for (auto ja = j0; ja < j1; ja += tile) {
+                const auto jb = std::min(ja + tile, j1);
+                const auto w = aa.data() + ja * nc;
+
+                const auto load = [&](const size_t& y, Mar* n) {
+                    const auto c = cv[y].data();
+                    if (y == 0 || y == ny - 1) {
+                        std::fill(c + (ja - j0), c + (jb - j0), ze);
+                        std::fill(n, n + (jb - ja) * nc, ze);
+                        return;
+                    }
+
+                    for (auto j = ja; j < jb; ++j) {
+                        for (size_t i = 0; i < nc; ++i)
+                            *n++ = c[j - j0];
+                        c[j - j0] *= a0[j];
+                    }
+                };
+
+                const auto store = [&](const size_t& y, const Mar* n) {
+                    const auto c = cv[y].data();
+                    for (size_t j = ja, k = 0; j < jb; ++j, k += nc) {
+                        auto sum = ze;
+                        for (size_t i = 0; i < nc; ++i)
+                            sum += w[k + i] * n[k + i];
+                        c[j - j0] += sum;
+                    }
+                };
+
+                solver.substitute(nv.data(), ld, (ja - j0) * nc, (jb - j0) * nc, load, store);
+            }
+        }
+
+        //field rows [i0, i1) of modes [j0, j1), cv holds only columns of these modes
+        template<typename VL>
+        void _project(const utils::tensor<Mar, 2>& cv, const _phases<VL>& phase, const utils::tensor<Mrg, 3>& ph,
+                      types::vector1d_t<Mar>& sc, const size_t& j0, const size_t& j1, const size_t& nw,
+                      const size_t& i0, const size_t& i1, const utils::tensor_view<Mar, 2>& ov) const {
+            for (size_t i = i0, y = i0 + nw; i < i1; ++i, ++y) {
+                ov[i].fill(ze);
+                for (size_t j = j0; j < j1; ++j)
+                    sc[j - j0] = cv(y, j - j0) * Mar(phase[j]);
+                utils::project(ph.data() + (j0 * _ny + i) * _nz, _ny * _nz, sc.data(), j1 - j0, ov[i].data(), _nz);
+            }
+        }
+
+        struct _team {
+
+            _team(const size_t& ny, const size_t& nb, const size_t& np, const size_t& my, const size_t& mz, utils::tensor<Mar, 2> cv) :
+                solver(ny, nb, np), sync(np), ov({ 2, my, mz }), cv(std::move(cv)) {}
+
+            utils::partitioned_thomas_solver<Mar, Val> solver;
+            utils::barrier sync;
+            utils::tensor<Mar, 3> ov;
+            utils::tensor<Mar, 2> cv;
+
+        };
+
+        //march of thread p of a team, update prepares bands and mode functions of its rows before every step;
+        //the field of a step is complete only after the next barrier, so thread 0 passes it to call one step later
+        template<typename VL, typename UP, typename CL>
+        void _run_team(_team& team, const size_t& p, const size_t& j0, const size_t& j1,
+                       const types::vector1d_t<VL>& k0, const types::vector1d_t<Mar>& a0, const types::vector1d_t<Mar>& aa,
+                       const size_t& nc, const size_t& nw, const utils::tensor<Mrg, 3>& ph,
+                       const utils::output_schedule& schedule, const UP& update, CL&& call) const {
+            const auto [r0, r1] = team.solver.rows(p);
+            auto& cv = team.cv;
+            const auto i0 = std::clamp(r0, nw, nw + _ny) - nw;
+            const auto i1 = std::clamp(r1, nw, nw + _ny) - nw;
+
+            utils::tensor<Mar, 2> nv({ r1 - r0, (j1 - j0) * nc });
+            types::vector1d_t<Mar> sc(j1 - j0);
+            auto phase = _phases<VL>(k0, j0, j1, _x0 + _hx, _hx);
+
+            auto x = _x0 + _hx, lx = x;
+            auto pending = false;
+            for (size_t s = 1; s < _nx; ++s) {
+                const auto parity = s % 2;
+                const auto output = schedule.contains(s);
+
+                update(r0, r1, i0, i1, x, output, parity);
+                _prepare(a0, nc, j0, j1, cv, nv, r0, r1);
+                team.solver.forward(p, nv.data(), parity);
+
+                team.sync.wait();
+                if (p == 0 && pending) {
+                    call(lx, team.ov[1 - parity]);
+                    pending = false;
+                }
+
+                team.solver.backward(p, nv.data(), parity);
+                _accumulate(aa, nc, j0, j1, cv, nv, r0, r1);
+
+                if (output) {
+                    _project(cv, phase, ph, sc, j0, j1, nw, i0, i1, team.ov[parity]);
+                    pending = true;
+                    lx = x;
+                }
 
-            if (num_workers <= 1) {
-                solve_func(0, mc, callback);
+                phase.advance();
+                x += _hx;
+            }
+
+            team.sync.wait();
+            if (p == 0 && pending)
+                call(lx, team.ov[(_nx - 1) % 2]);
+        }
+
+        //modes are split into chunks that are marched in blocks of range steps by whichever worker is free,
+        //the chunk furthest behind goes first and a block ends early once the chunk has no free output slot,
+        //so a worker never waits inside a block; when there are more workers than modes every mode is instead
+        //given a team of workers that split its rows; partial fields are published through per-chunk slots and
+        //atomic counters and summed in order by the output thread
+        template<typename MC, typename MT, typename CL>
+        void _compute(const MC& make_chunk, const MT& make_team, CL&& callback, const utils::output_schedule& schedule,
+                      const size_t mc, size_t num_workers, const size_t buff_size) const {
+            if (num_workers <= 1 || mc == 0) {
+                auto chunk = make_chunk(0, mc);
+                for (size_t s = 1; s < _nx; ++s)
+                    chunk(callback);
                 return;
             }
 
             --num_workers; // one worker is used to output data
 
-            types::vector1d_t<std::mutex> buff_mutex(buff_size);
-            types::vector1d_t<std::condition_variable> buff_cv(buff_size);
-            types::vector2d_t<bool> done_buff(buff_size, types::vector1d_t<bool>(num_workers, false));
-            types::vector3d_t<Val> ov_buff(buff_size, types::vector2d_t<Val>(_ny, types::vector1d_t<Val>(_nz, ze)));
+            const auto np = mc < num_workers ? std::min(num_workers / mc, _ny / _min_rows) : size_t(1);
+            const auto nch = np > 1 ? mc : std::min(mc, num_workers * _chunks_per_worker);
+            // total memory matches a shared buffer of buff_size fields
+            const auto depth = std::max(size_t(1), (buff_size + nch - 1) / nch);
+            const auto size = _ny * _nz;
+
+            utils::tensor<Mar, 4> slots({ nch, depth, _ny, _nz });
+            utils::tensor<Mar, 2> ov({ _ny, _nz });
+
+            std::atomic<size_t> consumed(0), finished(0);
+            types::vector1d_t<std::atomic<bool>> busy(nch);
+            types::vector1d_t<std::atomic<size_t>> steps(nch), produced(nch);
+            for (size_t c = 0; c < nch; ++c) {
+                busy[c].store(false, std::memory_order_relaxed);
+                steps[c].store(1, std::memory_order_relaxed);
+                produced[c].store(0, std::memory_order_relaxed);
+            }
 
-            const auto mpw = mc / num_workers;
+            const auto has_room = [&](const size_t& c) {
+                return produced[c].load(std::memory_order_relaxed) - consumed.load(std::memory_order_acquire) < depth;
+            };
 
-            types::vector1d_t<std::thread> workers;
-            workers.reserve(num_workers);
-
-            for (size_t i = 0; i < num_workers; ++i)
-                workers.emplace_back([&, i](){
-                    solve_func(mpw * i, i == num_workers - 1 ? mc : mpw * (i + 1), [&, i, in=size_t(0)](const auto& x, const auto& data) mutable {
-                        std::unique_lock<std::mutex> lk(buff_mutex[in]);
-                        if (done_buff[in][i])
-                            buff_cv[in].wait(lk, [&]{ return !done_buff[in][i]; });
-
-                        for (size_t m = 0; m < _ny; ++m)
-                            for (size_t z = 0; z < _nz; ++z)
-                                ov_buff[in][m][z] += data[m][z];
-
-                        done_buff[in][i] = true;
-                        if (_all(done_buff[in])) {
-                            lk.unlock();
-                            buff_cv[in].notify_all();
-                        } else
-                            lk.unlock();
-
-                        in = (in + 1) % buff_size;
-                    });
-                });
+            const auto publish = [&](const size_t& c, const auto& data) {
+                const auto n = produced[c].load(std::memory_order_relaxed);
+                std::copy(data.data(), data.data() + size, slots[c][n % depth].data());
+                produced[c].store(n + 1, std::memory_order_release);
+            };
 
-            for (size_t in = 1, bi = 0; in < _nx; ++in, bi = (bi + 1) % buff_size) {
-                std::unique_lock<std::mutex> lk(buff_mutex[bi]);
-                if (!_all(done_buff[bi]))
-                    buff_cv[bi].wait(lk, [&]{ return _all(done_buff[bi]); });
+            types::vector1d_t<std::thread> workers;
 
-                callback(_x0 + in * _hx, ov_buff[bi]);
+            using team_t = decltype(make_team(0, 0, 0));
+            types::vector1d_t<team_t> teams;
+
+            using chunk_t = decltype(make_chunk(0, 0));
+            types::vector1d_t<chunk_t> chunks;
+
+            if (np > 1) {
+                teams.reserve(nch);
+                workers.reserve(nch * np);
+                for (size_t c = 0; c < nch; ++c) {
+                    teams.emplace_back(make_team(c, c + 1, np));
+                    for (size_t p = 0; p < np; ++p)
+                        workers.emplace_back([&, c, p](){
+                            teams[c](p, [&, c](const auto& x, const auto& data) {
+                                while (!has_room(c))
+                                    std::this_thread::yield();
+                                publish(c, data);
+                            });
+                        });
+                }
+            } else {
+                chunks.reserve(nch);
+                for (size_t c = 0; c < nch; ++c)
+                    chunks.emplace_back(make_chunk(mc * c / nch, mc * (c + 1) / nch));
+
+                const auto acquire = [&]() {
+                    auto result = nch;
+                    for (size_t c = 0; c < nch; ++c) {
+                        const auto s = steps[c].load(std::memory_order_relaxed);
+                        if (s < _nx && !busy[c].load(std::memory_order_relaxed) && (!schedule.contains(s) || has_room(c)) &&
+                            (result == nch || s < steps[result].load(std::memory_order_relaxed)))
+                            result = c;
+                    }
+                    return result == nch || busy[result].exchange(true, std::memory_order_acq_rel) ? nch : result;
+                };
+
+                num_workers = std::min(mc, num_workers);
+                workers.reserve(num_workers);
+                for (size_t i = 0; i < num_workers; ++i)
+                    workers.emplace_back([&, acquire](){
+                        while (finished.load(std::memory_order_acquire) < nch) {
+                            const auto c = acquire();
+                            if (c == nch) {
+                                std::this_thread::yield();
+                                continue;
+                            }
+
+                            auto s = steps[c].load(std::memory_order_relaxed);
+                            for (size_t b = 0; b < _block && s < _nx && (!schedule.contains(s) || has_room(c)); ++b) {
+                                chunks[c]([&](const auto& x, const auto& data) { publish(c, data); });
+                                steps[c].store(++s, std::memory_order_relaxed);
+                            }
+
+                            if (s == _nx)
+                                finished.fetch_add(1, std::memory_order_acq_rel);
+                            busy[c].store(false, std::memory_order_release);
+                        }
+                    });
+            }
 
-                for (size_t y = 0; y < _ny; ++y)
-                    ov_buff[bi][y].assign(_nz, ze);
+            for (size_t in = schedule.next(1, _nx), n = 0; in < _nx; in = schedule.next(in + 1, _nx), ++n) {
+                const auto dst = ov.data();
+                for (size_t c = 0; c < nch; ++c) {
+                    while (produced[c].load(std::memory_order_acquire) <= n)
+                        std::this_thread::yield();
+
+                    const auto src = slots[c][n % depth].data();
+                    if (c == 0)
+                        std::copy(src, src + size, dst);
+                    else
+                        for (size_t k = 0; k < size; ++k)
+                            dst[k] += src[k];
+                }
 
-                done_buff[bi].assign(num_workers, false);
-                lk.unlock();
-                buff_cv[bi].notify_all();
+                consumed.store(n + 1, std::memory_order_release);
+                callback(_x0 + in * _hx, ov.view());
             }
 
             for (auto& it : workers)
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <cstddef>
+
+namespace ample::utils {
+
+    //reusable spinning barrier for a fixed number of threads
+    class barrier {
+
+    public:
+
+        explicit barrier(const size_t& n) : _n(n), _count(n), _generation(0) {}
+
+        barrier(const barrier&) = delete;
+        barrier& operator=(const barrier&) = delete;
+
+        void wait() {
+            const auto generation = _generation.load(std::memory_order_acquire);
+            if (_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                _count.store(_n, std::memory_order_relaxed);
+                _generation.fetch_add(1, std::memory_order_release);
+                return;
+            }
+
+            while (_generation.load(std::memory_order_acquire) == generation)
+                std::this_thread::yield();
+        }
+
+    private:
+
+        const size_t _n;
+        std::atomic<size_t> _count, _generation;
+
+    };
+
+}// namespace ample::utils
@@ -3,7 +3,10 @@
 #include <utility>
 #include <iostream>
 #include <functional>
+#include <type_traits>
 #include "types.hpp"
+#include "tensor.hpp"
+#include "schedule.hpp"
 #include "verbosity.hpp"
 #include "progress_bar.hpp"
 
@@ -83,6 +86,50 @@ namespace ample::utils {
 
         };
 
+        template<typename Callback>
+        class schedule_callback {
+
+        public:
+
+            schedule_callback(output_schedule own, output_schedule delivered, const size_t& n, Callback&& callback) :
+                _n(n), _step(delivered.next(0, n)), _own(std::move(own)), _delivered(std::move(delivered)), _callback(std::move(callback)) {}
+
+            template<typename T, typename D>
+            void operator()(const T& x, const D& data) {
+                if (_own.contains(_step))
+                    _callback(x, data);
+                _step = _delivered.next(_step + 1, _n);
+            }
+
+        private:
+
+            const size_t _n;
+            size_t _step;
+            const output_schedule _own, _delivered;
+            Callback _callback;
+
+        };
+
+        template<typename T, typename Callback>
+        class convert_callback {
+
+        public:
+
+            explicit convert_callback(Callback&& callback) : _callback(std::move(callback)) {}
+
+            template<typename X, typename D>
+            void operator()(const X& x, const D& data) {
+                _buffer.assign(data);
+                _callback(x, _buffer.view());
+            }
+
+        private:
+
+            tensor<T, 2> _buffer;
+            Callback _callback;
+
+        };
+
         class progress_bar_callback {
 
         public:
@@ -134,6 +181,19 @@ namespace ample::utils {
         return ekc_callback(k, std::forward<DCallback>(data_callback), nothing_callback());
     }
 
+    //passes through only steps of own schedule given that calls are made on steps of delivered schedule
+    template<typename Callback>
+    auto schedule_callback(const output_schedule& own, const output_schedule& delivered, const size_t& n, Callback&& callback) {
+        return _impl::schedule_callback(own, delivered, n, _impl::propagate(callback, _impl::_empty<Callback>{}));
+    }
+
+    //passes data converted to elements of type T, e.g. fields of a single precision solver to double writers
+    template<typename T, typename Callback>
+    auto convert_callback(Callback&& callback) {
+        using C = std::decay_t<decltype(_impl::propagate(callback, _impl::_empty<Callback>{}))>;
+        return _impl::convert_callback<T, C>(_impl::propagate(callback, _impl::_empty<Callback>{}));
+    }
+
     template<typename DCallback>
     auto progress_callback(const size_t k, const verbosity& verbosity, DCallback&& data_callback, const size_t& level = 2) {
         return ekc_callback(k, std::forward<DCallback>(data_callback),
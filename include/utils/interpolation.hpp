@@ -84,6 +84,12 @@ namespace ample::utils {
             return static_cast<remove_reference_wrapper_t<T>&>(value);
         }
 
+        //rows of tensor views are temporaries and are passed through by value
+        template<typename T, typename = std::enable_if_t<!std::is_lvalue_reference_v<T>>>
+        auto remove_reference_wrapper_v(T&& value) {
+            return std::move(value);
+        }
+
         class linear_interpolation {
 
         public:
@@ -281,9 +287,9 @@ namespace ample::utils {
                 const auto [yi, yj, dy1, dy2, dy12] = _impl::fill_bilinear_interpolation_coefficients(y0, y1, ny, ys);
                 const auto [zi, zj, dz1, dz2, dz12] = _impl::fill_bilinear_interpolation_coefficients(z0, z1, nz, zs);
                 for (size_t i = 0; i < nx; ++i) {
-                    auto& ry = remove_reference_wrapper_v(result[i]);
+                    auto&& ry = remove_reference_wrapper_v(result[i]);
                     for (size_t j = 0; j < ny; ++j) {
-                        auto& rz = remove_reference_wrapper_v(ry[j]);
+                        auto&& rz = remove_reference_wrapper_v(ry[j]);
                         for (size_t k = 0; k < nz; ++k) {
                             rz[k] = 
                                 (
@@ -607,12 +613,13 @@ namespace ample::utils {
 
         };
 
-        template<typename T, typename V = T>
+        //values may be held in any container indexed as data[x]..., e.g. a view of contiguous storage
+        template<typename T, typename V = T, typename D = types::vector1d_t<V>>
         class linear_interpolator_1d : public interpolator_1d<T, V> {
 
         public:
 
-            using data_t = types::vector1d_t<V>;
+            using data_t = D;
             using typename interpolator_1d<T, V>::line_t;
             using args_t = std::tuple<types::vector1d_t<T>>;
 
@@ -676,12 +683,12 @@ namespace ample::utils {
 
         };
 
-        template<typename T, typename V = T>
+        template<typename T, typename V = T, typename D = types::vector2d_t<V>>
         class linear_interpolator_2d : public interpolator_2d<T, V> {
 
         public:
 
-            using data_t = types::vector2d_t<V>;
+            using data_t = D;
             using typename interpolator_2d<T, V>::line_t;
             using typename interpolator_2d<T, V>::field_t;
             using args_t = std::tuple<types::vector1d_t<T>, types::vector1d_t<T>>;
@@ -948,12 +955,12 @@ namespace ample::utils {
 
         };
 
-        template<typename T, typename V = T>
+        template<typename T, typename V = T, typename D = types::vector3d_t<V>>
         class linear_interpolator_3d : public interpolator_3d<T, V> {
 
         public:
 
-            using data_t = types::vector3d_t<V>;
+            using data_t = D;
             using typename interpolator_3d<T, V>::line_t;
             using typename interpolator_3d<T, V>::field_t;
             using typename interpolator_3d<T, V>::area_t;
@@ -999,6 +1006,12 @@ namespace ample::utils {
                 _impl::linear_interpolation::area_field(x, y0, y1, z0, z1, this->x(), y(), z(), _data, res);
             }
 
+            //fills any container indexed as res[y][z], e.g. a tensor view
+            template<typename RV>
+            void field(const T& x, const T& y0, const T& y1, const T& z0, const T& z1, RV& res) const {
+                _impl::linear_interpolation::area_field(x, y0, y1, z0, z1, this->x(), y(), z(), _data, res);
+            }
+
             void field(const T& x, field_t& res) const {
                 field(x, y().front(), y().back(), z().front(), z().back(), res);
             }
@@ -1069,14 +1082,14 @@ namespace ample::utils {
     template<typename I>
     using interpolated_data = _impl::interpolated_data<I, typename I::args_t>;
 
-    template<typename T, typename V = T>
-    using linear_interpolated_data_1d = interpolated_data<interpolators::linear_interpolator_1d<T, V>>;
+    template<typename T, typename V = T, typename D = types::vector1d_t<V>>
+    using linear_interpolated_data_1d = interpolated_data<interpolators::linear_interpolator_1d<T, V, D>>;
 
-    template<typename T, typename V = T>
-    using linear_interpolated_data_2d = interpolated_data<interpolators::linear_interpolator_2d<T, V>>;
+    template<typename T, typename V = T, typename D = types::vector2d_t<V>>
+    using linear_interpolated_data_2d = interpolated_data<interpolators::linear_interpolator_2d<T, V, D>>;
     
-    template<typename T, typename V = T>
-    using linear_interpolated_data_3d = interpolated_data<interpolators::linear_interpolator_3d<T, V>>;
+    template<typename T, typename V = T, typename D = types::vector3d_t<V>>
+    using linear_interpolated_data_3d = interpolated_data<interpolators::linear_interpolator_3d<T, V, D>>;
 
     template<typename T, typename V = T>
     using delaunay_interpolated_data_2d = interpolated_data<interpolators::delaunay_interpolator_2d<T, V>>;
@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <fstream>
+#include <filesystem>
+#include "tensor.hpp"
+#include "assert.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define AMPLE_HAS_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace ample::utils {
+
+    //whole file mapped into memory; where mmap is not available the file is read into memory instead,
+    //and a created file is written out when the mapping is destroyed
+    class mapped_file {
+
+    public:
+
+        //maps an existing file copy on write, pages are read only when touched and changes never reach the file
+        explicit mapped_file(const std::filesystem::path& path) : _path(path) {
+#ifdef AMPLE_HAS_MMAP
+            const auto fd = ::open(path.c_str(), O_RDONLY);
+            dynamic_assert(fd >= 0, "Could not open file ", path.generic_string());
+
+            struct stat info {};
+            if (::fstat(fd, &info) == 0)
+                _size = size_t(info.st_size);
+            _map(fd, MAP_PRIVATE);
+#else
+            std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
+            dynamic_assert(bool(file), "Could not open file ", path.generic_string());
+
+            _size = size_t(file.tellg());
+            _buffer.resize({ _size });
+            _data = _buffer.data();
+            file.seekg(0);
+            dynamic_assert(bool(file.read(_data, _size)), "Could not read file ", path.generic_string());
+#endif
+        }
+
+        //creates a file of the given size filled with zeros and maps it shared, so changes are written to the file
+        mapped_file(const std::filesystem::path& path, const size_t& size) : _path(path), _size(size) {
+#ifdef AMPLE_HAS_MMAP
+            const auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            dynamic_assert(fd >= 0, "Could not create file ", path.generic_string());
+
+            if (::ftruncate(fd, off_t(size)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Could not resize file " + path.generic_string());
+            }
+            _map(fd, MAP_SHARED);
+#else
+            _buffer.resize({ _size });
+            _data = _buffer.data();
+            _created = true;
+#endif
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        ~mapped_file() {
+#ifdef AMPLE_HAS_MMAP
+            if (_data)
+                ::munmap(_data, _size);
+#else
+            if (_created)
+                std::ofstream(_path, std::ios_base::binary).write(_data, _size);
+#endif
+        }
+
+        [[nodiscard]] char* data() const {
+            return _data;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] const auto& path() const {
+            return _path;
+        }
+
+    private:
+
+        const std::filesystem::path _path;
+        char* _data = nullptr;
+        size_t _size = 0;
+#ifdef AMPLE_HAS_MMAP
+
+        void _map(const int& fd, const int& flags) {
+            if (_size > 0) {
+                const auto data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, flags, fd, 0);
+                _data = data == MAP_FAILED ? nullptr : static_cast<char*>(data);
+            }
+            ::close(fd);
+            dynamic_assert(_data != nullptr || _size == 0, "Could not map file ", _path.generic_string());
+        }
+#else
+        tensor<char, 1> _buffer;
+        bool _created = false;
+#endif
+
+    };
+
+}// namespace ample::utils
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <complex>
+#include <algorithm>
+#include <type_traits>
+
+namespace ample::utils {
+
+    namespace _impl {
+
+        template<typename T>
+        struct is_complex : std::false_type {};
+
+        template<typename T>
+        struct is_complex<std::complex<T>> : std::true_type {};
+
+        //real functions times complex amplitudes, z is processed in tiles with separate real and imaginary accumulators
+        //and modes are unrolled by four so every loaded accumulator is updated with several products
+        template<typename T, size_t Tile = 64>
+        void project_real(const T* p, const size_t& ld, const std::complex<T>* c, const size_t& nm,
+                          std::complex<T>* o, const size_t& nz) {
+            T re[Tile], im[Tile];
+
+            for (size_t z0 = 0; z0 < nz; z0 += Tile) {
+                const auto nt = std::min(Tile, nz - z0);
+                std::fill(re, re + nt, T(0));
+                std::fill(im, im + nt, T(0));
+
+                size_t j = 0;
+                for (; j + 4 <= nm; j += 4) {
+                    const auto p0 = p + j * ld + z0, p1 = p0 + ld, p2 = p1 + ld, p3 = p2 + ld;
+                    const auto r0 = c[j].real(), r1 = c[j + 1].real(), r2 = c[j + 2].real(), r3 = c[j + 3].real();
+                    const auto i0 = c[j].imag(), i1 = c[j + 1].imag(), i2 = c[j + 2].imag(), i3 = c[j + 3].imag();
+                    for (size_t z = 0; z < nt; ++z) {
+                        re[z] += p0[z] * r0 + p1[z] * r1 + p2[z] * r2 + p3[z] * r3;
+                        im[z] += p0[z] * i0 + p1[z] * i1 + p2[z] * i2 + p3[z] * i3;
+                    }
+                }
+
+                for (; j < nm; ++j) {
+                    const auto pj = p + j * ld + z0;
+                    const auto rj = c[j].real(), ij = c[j].imag();
+                    for (size_t z = 0; z < nt; ++z) {
+                        re[z] += pj[z] * rj;
+                        im[z] += pj[z] * ij;
+                    }
+                }
+
+                for (size_t z = 0; z < nt; ++z)
+                    o[z0 + z] += std::complex<T>(re[z], im[z]);
+            }
+        }
+
+    }// namespace _impl
+
+    //o[z] += sum of p[j * ld + z] * c[j] over j < nm for every z < nz
+    template<typename P, typename V>
+    void project(const P* p, const size_t& ld, const V* c, const size_t& nm, V* o, const size_t& nz) {
+        if constexpr (!_impl::is_complex<P>::value && std::is_same_v<V, std::complex<P>>)
+            _impl::project_real(p, ld, c, nm, o, nz);
+        else
+            for (size_t j = 0; j < nm; ++j)
+                for (size_t z = 0; z < nz; ++z)
+                    o[z] += p[j * ld + z] * c[j];
+    }
+
+}// namespace ample::utils
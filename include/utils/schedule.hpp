@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include "types.hpp"
+#include "assert.hpp"
+
+namespace ample::utils {
+
+    //set of range steps whose values are consumed by callbacks
+    class output_schedule {
+
+    public:
+
+        //every step
+        output_schedule() = default;
+
+        //every k-th step starting from the first one
+        explicit output_schedule(const size_t& k) : _k(k) {
+            utils::dynamic_assert(k > 0, "Output step(", k, ") must be positive");
+        }
+
+        //explicit list of steps
+        explicit output_schedule(types::vector1d_t<size_t> steps) : _k(0), _steps(std::move(steps)) {
+            std::sort(_steps.begin(), _steps.end());
+            _steps.erase(std::unique(_steps.begin(), _steps.end()), _steps.end());
+        }
+
+        [[nodiscard]] bool contains(const size_t& i) const {
+            if (_k)
+                return i % _k == 0;
+            return std::binary_search(_steps.begin(), _steps.end(), i);
+        }
+
+        //first scheduled step not less than i or n if there is none below n
+        [[nodiscard]] size_t next(const size_t& i, const size_t& n) const {
+            if (_k)
+                return std::min(n, (i + _k - 1) / _k * _k);
+            const auto it = std::lower_bound(_steps.begin(), _steps.end(), i);
+            return it == _steps.end() ? n : std::min(n, *it);
+        }
+
+        //number of scheduled steps below n
+        [[nodiscard]] size_t count(const size_t& n) const {
+            if (_k)
+                return n ? (n - 1) / _k + 1 : 0;
+            return std::distance(_steps.begin(), std::lower_bound(_steps.begin(), _steps.end(), n));
+        }
+
+        [[nodiscard]] types::vector1d_t<size_t> steps(const size_t& n) const {
+            types::vector1d_t<size_t> result;
+            result.reserve(count(n));
+            for (auto i = next(0, n); i < n; i = next(i + 1, n))
+                result.push_back(i);
+            return result;
+        }
+
+        [[nodiscard]] bool all() const {
+            return _k == 1;
+        }
+
+    private:
+
+        size_t _k = 1;
+        types::vector1d_t<size_t> _steps;
+
+    };
+
+    inline auto merge(const output_schedule& a, const output_schedule& b, const size_t& n) {
+        if (a.all() || b.all())
+            return output_schedule();
+
+        auto steps = a.steps(n);
+        const auto other = b.steps(n);
+        steps.insert(steps.end(), other.begin(), other.end());
+        return output_schedule(std::move(steps));
+    }
+
+}// namespace ample::utils
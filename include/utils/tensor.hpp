@@ -0,0 +1,365 @@
+#pragma once
+#include <new>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+namespace ample::utils {
+
+    template<typename T, size_t N>
+    class tensor_view;
+
+    namespace _impl {
+
+        template<typename T, size_t Alignment>
+        struct aligned_allocator {
+
+            using value_type = T;
+
+            template<typename U>
+            struct rebind {
+
+                using other = aligned_allocator<U, Alignment>;
+
+            };
+
+            aligned_allocator() = default;
+
+            template<typename U>
+            aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+            T* allocate(const size_t n) {
+                return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+            }
+
+            void deallocate(T* p, const size_t) {
+                ::operator delete(p, std::align_val_t(Alignment));
+            }
+
+            template<typename U>
+            bool operator==(const aligned_allocator<U, Alignment>&) const {
+                return true;
+            }
+
+            template<typename U>
+            bool operator!=(const aligned_allocator<U, Alignment>&) const {
+                return false;
+            }
+
+        };
+
+        template<size_t N>
+        size_t product(const std::array<size_t, N>& shape, const size_t from = 0) {
+            size_t result = 1;
+            for (size_t i = from; i < N; ++i)
+                result *= shape[i];
+            return result;
+        }
+
+        template<size_t N>
+        auto tail(const std::array<size_t, N>& shape) {
+            std::array<size_t, N - 1> result;
+            std::copy(shape.begin() + 1, shape.end(), result.begin());
+            return result;
+        }
+
+        //iterates over the first dimension of a view yielding its rows
+        template<typename T, size_t N>
+        class tensor_iterator {
+
+        public:
+
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = tensor_view<T, N - 1>;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = void;
+            using reference         = value_type;
+
+            tensor_iterator(const tensor_view<T, N>& view, const size_t& i) : _view(view), _i(i) {}
+
+            reference operator*() const {
+                return _view[_i];
+            }
+
+            reference operator[](const difference_type& n) const {
+                return _view[_i + n];
+            }
+
+            tensor_iterator& operator++() {
+                ++_i;
+                return *this;
+            }
+
+            tensor_iterator operator++(int) {
+                auto result = *this;
+                ++_i;
+                return result;
+            }
+
+            tensor_iterator& operator--() {
+                --_i;
+                return *this;
+            }
+
+            tensor_iterator operator--(int) {
+                auto result = *this;
+                --_i;
+                return result;
+            }
+
+            tensor_iterator& operator+=(const difference_type& n) {
+                _i += n;
+                return *this;
+            }
+
+            tensor_iterator& operator-=(const difference_type& n) {
+                _i -= n;
+                return *this;
+            }
+
+            tensor_iterator operator+(const difference_type& n) const {
+                return tensor_iterator(_view, _i + n);
+            }
+
+            tensor_iterator operator-(const difference_type& n) const {
+                return tensor_iterator(_view, _i - n);
+            }
+
+            difference_type operator-(const tensor_iterator& other) const {
+                return difference_type(_i) - difference_type(other._i);
+            }
+
+            bool operator==(const tensor_iterator& other) const {
+                return _i == other._i;
+            }
+
+            bool operator!=(const tensor_iterator& other) const {
+                return _i != other._i;
+            }
+
+            bool operator<(const tensor_iterator& other) const {
+                return _i < other._i;
+            }
+
+        private:
+
+            tensor_view<T, N> _view;
+            size_t _i;
+
+        };
+
+    }// namespace _impl
+
+    //non-owning view of a contiguous row-major tensor, indexing a rank N view yields a rank N - 1 view
+    template<typename T, size_t N>
+    class tensor_view {
+
+        static_assert(N > 0, "Tensor rank must be positive");
+
+    public:
+
+        using value_type = std::remove_const_t<T>;
+
+        tensor_view(T* data, const std::array<size_t, N>& shape) : _data(data), _shape(shape), _stride(_impl::product(shape, 1)) {}
+
+        template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+        tensor_view(const tensor_view<U, N>& other) : tensor_view(other.data(), other.shape()) {}
+
+        decltype(auto) operator[](const size_t& i) const {
+            if constexpr (N == 1)
+                return _data[i];
+            else
+                return tensor_view<T, N - 1>(_data + i * _stride, _impl::tail(_shape));
+        }
+
+        template<typename... I>
+        T& operator()(const I&... indices) const {
+            static_assert(sizeof...(I) == N, "Number of indices must match tensor rank");
+            size_t index = 0, i = 0;
+            ((index = index * _shape[i++] + indices), ...);
+            return _data[index];
+        }
+
+        auto begin() const {
+            if constexpr (N == 1)
+                return _data;
+            else
+                return _impl::tensor_iterator<T, N>(*this, 0);
+        }
+
+        auto end() const {
+            if constexpr (N == 1)
+                return _data + _shape[0];
+            else
+                return _impl::tensor_iterator<T, N>(*this, _shape[0]);
+        }
+
+        void fill(const value_type& value) const {
+            std::fill(_data, _data + count(), value);
+        }
+
+        [[nodiscard]] T* data() const {
+            return _data;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _shape[0];
+        }
+
+        [[nodiscard]] size_t count() const {
+            return _shape[0] * _stride;
+        }
+
+        [[nodiscard]] const auto& shape() const {
+            return _shape;
+        }
+
+        [[nodiscard]] size_t shape(const size_t& i) const {
+            return _shape[i];
+        }
+
+        [[nodiscard]] bool empty() const {
+            return count() == 0;
+        }
+
+    private:
+
+        T* _data;
+        std::array<size_t, N> _shape;
+        size_t _stride;
+
+    };
+
+    //view that keeps the storage it looks at alive, e.g. a block shared by several views or a mapped file
+    template<typename T, size_t N>
+    class shared_tensor_view : public tensor_view<T, N> {
+
+    public:
+
+        shared_tensor_view(std::shared_ptr<const void> owner, T* data, const std::array<size_t, N>& shape) :
+            tensor_view<T, N>(data, shape), _owner(std::move(owner)) {}
+
+    private:
+
+        std::shared_ptr<const void> _owner;
+
+    };
+
+    //owning contiguous row-major tensor with cache line aligned storage
+    template<typename T, size_t N>
+    class tensor {
+
+    public:
+
+        using value_type = T;
+        static constexpr size_t alignment = 64;
+
+        tensor() {
+            _shape.fill(0);
+        }
+
+        explicit tensor(const std::array<size_t, N>& shape, const T& value = T()) :
+            _shape(shape), _data(_impl::product(shape), value) {}
+
+        template<typename U>
+        explicit tensor(const tensor_view<U, N>& view) {
+            assign(view);
+        }
+
+        decltype(auto) operator[](const size_t& i) {
+            return view()[i];
+        }
+
+        decltype(auto) operator[](const size_t& i) const {
+            return view()[i];
+        }
+
+        template<typename... I>
+        T& operator()(const I&... indices) {
+            return view()(indices...);
+        }
+
+        template<typename... I>
+        const T& operator()(const I&... indices) const {
+            return view()(indices...);
+        }
+
+        auto begin() {
+            return view().begin();
+        }
+
+        auto end() {
+            return view().end();
+        }
+
+        auto begin() const {
+            return view().begin();
+        }
+
+        auto end() const {
+            return view().end();
+        }
+
+        [[nodiscard]] tensor_view<T, N> view() {
+            return tensor_view<T, N>(_data.data(), _shape);
+        }
+
+        [[nodiscard]] tensor_view<const T, N> view() const {
+            return tensor_view<const T, N>(_data.data(), _shape);
+        }
+
+        void fill(const T& value) {
+            std::fill(_data.begin(), _data.end(), value);
+        }
+
+        void resize(const std::array<size_t, N>& shape) {
+            _shape = shape;
+            _data.resize(_impl::product(shape));
+        }
+
+        template<typename U>
+        void assign(const tensor_view<U, N>& view) {
+            _shape = view.shape();
+            _data.assign(view.data(), view.data() + view.count());
+        }
+
+        [[nodiscard]] T* data() {
+            return _data.data();
+        }
+
+        [[nodiscard]] const T* data() const {
+            return _data.data();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _shape[0];
+        }
+
+        [[nodiscard]] size_t count() const {
+            return _data.size();
+        }
+
+        [[nodiscard]] const auto& shape() const {
+            return _shape;
+        }
+
+        [[nodiscard]] size_t shape(const size_t& i) const {
+            return _shape[i];
+        }
+
+        [[nodiscard]] bool empty() const {
+            return _data.empty();
+        }
+
+    private:
+
+        std::array<size_t, N> _shape;
+        std::vector<T, _impl::aligned_allocator<T, alignment>> _data;
+
+    };
+
+}// namespace ample::utils
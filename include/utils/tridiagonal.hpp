@@ -0,0 +1,281 @@
+#pragma once
+#include <tuple>
+#include <cstddef>
+#include "types.hpp"
+#include "tensor.hpp"
+
+namespace ample::utils {
+
+    //thomas algorithm for a batch of tridiagonal systems stored interleaved,
+    //i.e. element y of system b is stored at y * ld + b, so every sweep step is a loop over the batch;
+    //bands may be given in a wider type F, then the factorization is computed in F and only stored in V
+    template<typename V, typename F = V>
+    class batched_thomas_solver {
+
+    public:
+
+        batched_thomas_solver(const size_t& ny, const size_t& nb) :
+            _ny(ny), _nb(nb), _a({ ny, nb }), _e({ ny, nb }), _r({ ny, nb }), _last({ nb }) {}
+
+        //a, b, c are bands with leading dimension ld, multipliers and reciprocal pivots are kept for substitute
+        void factorize(const F* a, const F* b, const F* c, const size_t& ld) {
+            const auto ep = _last.data();
+
+            for (size_t k = 0; k < _nb; ++k) {
+                const auto r = F(1) / b[k];
+                ep[k] = c[k] * r;
+                _r(0, k) = V(r);
+                _e(0, k) = V(ep[k]);
+            }
+
+            for (size_t y = 1; y < _ny; ++y) {
+                const auto ay = a + y * ld, by = b + y * ld, cy = c + y * ld;
+                const auto sa = _a.data() + y * _nb, se = _e.data() + y * _nb, sr = _r.data() + y * _nb;
+
+                for (size_t k = 0; k < _nb; ++k) {
+                    const auto r = F(1) / (by[k] - ay[k] * ep[k]);
+                    ep[k] = cy[k] * r;
+                    sa[k] = V(ay[k]);
+                    sr[k] = V(r);
+                    se[k] = V(ep[k]);
+                }
+            }
+        }
+
+        //d is right-hand side with leading dimension nb, solved in place using the last factorization
+        void substitute(V* d) const {
+            for (size_t k = 0; k < _nb; ++k)
+                d[k] *= _r(0, k);
+
+            for (size_t y = 1; y < _ny; ++y) {
+                const auto sa = _a.data() + y * _nb, sr = _r.data() + y * _nb;
+                const auto dp = d + (y - 1) * _nb, dy = d + y * _nb;
+
+                for (size_t k = 0; k < _nb; ++k)
+                    dy[k] = (dy[k] - sa[k] * dp[k]) * sr[k];
+            }
+
+            for (size_t y = _ny - 1; y > 0; --y) {
+                const auto ep = _e.data() + (y - 1) * _nb;
+                const auto dp = d + (y - 1) * _nb, dy = d + y * _nb;
+
+                for (size_t k = 0; k < _nb; ++k)
+                    dp[k] -= ep[k] * dy[k];
+            }
+        }
+
+        //solves systems [k0, k1) only; right-hand sides are not given in advance, load(y, dy) writes row y just before
+        //the forward sweep reaches it, and store(y, dy) is given row y of the solution as soon as the backward sweep
+        //is done with it, so every row is produced, solved and consumed while it is still in cache;
+        //d holds rows of these systems only, with leading dimension ld
+        template<typename L, typename S>
+        void substitute(V* d, const size_t& ld, const size_t& k0, const size_t& k1, L&& load, S&& store) const {
+            const auto n = k1 - k0;
+
+            load(size_t(0), d);
+            for (size_t k = 0; k < n; ++k)
+                d[k] *= _r(0, k0 + k);
+
+            for (size_t y = 1; y < _ny; ++y) {
+                const auto sa = _a.data() + y * _nb + k0, sr = _r.data() + y * _nb + k0;
+                const auto dp = d + (y - 1) * ld, dy = d + y * ld;
+
+                load(y, dy);
+                for (size_t k = 0; k < n; ++k)
+                    dy[k] = (dy[k] - sa[k] * dp[k]) * sr[k];
+            }
+
+            store(_ny - 1, d + (_ny - 1) * ld);
+            for (size_t y = _ny - 1; y > 0; --y) {
+                const auto ep = _e.data() + (y - 1) * _nb + k0;
+                const auto dp = d + (y - 1) * ld, dy = d + y * ld;
+
+                for (size_t k = 0; k < n; ++k)
+                    dp[k] -= ep[k] * dy[k];
+                store(y - 1, dp);
+            }
+        }
+
+        void operator()(const F* a, const F* b, const F* c, const size_t& ld, V* d) {
+            factorize(a, b, c, ld);
+            substitute(d);
+        }
+
+        [[nodiscard]] auto ny() const {
+            return _ny;
+        }
+
+        [[nodiscard]] auto nb() const {
+            return _nb;
+        }
+
+    private:
+
+        const size_t _ny, _nb;
+        tensor<V, 2> _a, _e, _r;
+        tensor<F, 1> _last;
+
+    };
+
+    //thomas algorithm for a batch of systems whose rows are split into np contiguous partitions, one per thread;
+    //every partition is factorized and solved on its own, then the values at partition ends are coupled through
+    //a small block tridiagonal system that every thread solves redundantly (partitioned thomas, spike)
+    //values shared between threads are double buffered by parity, so a single barrier between forward and backward
+    //is enough when consecutive solves alternate parity; F is the type of bands as in batched_thomas_solver,
+    //spikes and the coupling system are computed and kept in F as well, only corrections of d are cast to V
+    template<typename V, typename F = V>
+    class partitioned_thomas_solver {
+
+    public:
+
+        partitioned_thomas_solver(const size_t& ny, const size_t& nb, const size_t& np) :
+            _ny(ny), _nb(nb), _np(np), _coupling({ 2, np, 4, nb }), _ends({ 2, np, 2, nb }) {
+            _local.reserve(np);
+            for (size_t p = 0; p < np; ++p) {
+                const auto [r0, r1] = rows(p);
+                _local.emplace_back(r1 - r0, nb);
+                _v.emplace_back(std::array<size_t, 2>{ r1 - r0, nb });
+                _w.emplace_back(std::array<size_t, 2>{ r1 - r0, nb });
+                _alpha.emplace_back(nb);
+                _beta.emplace_back(nb);
+                _scratch.emplace_back(std::array<size_t, 3>{ np, 4, nb });
+                _values.emplace_back(std::array<size_t, 2>{ 3, nb });
+            }
+        }
+
+        [[nodiscard]] std::tuple<size_t, size_t> rows(const size_t& p) const {
+            return { _ny * p / _np, _ny * (p + 1) / _np };
+        }
+
+        //a, b, c are whole bands with leading dimension ld, only rows of partition p are used
+        void factorize(const size_t& p, const F* a, const F* b, const F* c, const size_t& ld, const size_t& parity) {
+            const auto [r0, r1] = rows(p);
+            const auto n = r1 - r0;
+            auto& v = _v[p];
+            auto& w = _w[p];
+
+            _local[p].factorize(a + r0 * ld, b + r0 * ld, c + r0 * ld, ld);
+
+            for (size_t k = 0; k < _nb; ++k) {
+                _alpha[p][k] = p > 0 ? a[r0 * ld + k] : F(0);
+                _beta[p][k] = p < _np - 1 ? c[(r1 - 1) * ld + k] : F(0);
+            }
+
+            //spikes are the columns of the inverse of the partition at its first and last rows, they are found
+            //by thomas in F; the forward sweep keeps multipliers in w, which the backward one replaces with w itself
+            for (size_t y = 0; y < n; ++y) {
+                const auto ay = a + (r0 + y) * ld, by = b + (r0 + y) * ld, cy = c + (r0 + y) * ld;
+                for (size_t k = 0; k < _nb; ++k) {
+                    const auto ap = y > 0 ? ay[k] : F(0);
+                    const auto ep = y > 0 ? w(y - 1, k) : F(0);
+                    const auto r = F(1) / (by[k] - ap * ep);
+                    v(y, k) = ((y == 0 ? F(1) : F(0)) - ap * (y > 0 ? v(y - 1, k) : F(0))) * r;
+                    w(y, k) = y + 1 < n ? cy[k] * r : r;
+                }
+            }
+
+            for (size_t y = n - 1; y-- > 0;)
+                for (size_t k = 0; k < _nb; ++k) {
+                    const auto ep = w(y, k);
+                    v(y, k) -= ep * v(y + 1, k);
+                    w(y, k) = -ep * w(y + 1, k);
+                }
+
+            auto coupling = _coupling[parity][p];
+            for (size_t k = 0; k < _nb; ++k) {
+                coupling(0, k) = _alpha[p][k] * v(0, k);
+                coupling(1, k) = _alpha[p][k] * v(n - 1, k);
+                coupling(2, k) = _beta[p][k] * w(0, k);
+                coupling(3, k) = _beta[p][k] * w(n - 1, k);
+            }
+        }
+
+        //d holds rows of partition p with leading dimension nb, solves it locally and publishes its ends
+        void forward(const size_t& p, V* d, const size_t& parity) {
+            const auto [r0, r1] = rows(p);
+            const auto n = r1 - r0;
+
+            _local[p].substitute(d);
+
+            auto ends = _ends[parity][p];
+            std::copy(d, d + _nb, ends[0].data());
+            std::copy(d + (n - 1) * _nb, d + n * _nb, ends[1].data());
+        }
+
+        //must follow forward of every partition, corrects d with values of the neighbouring partitions
+        void backward(const size_t& p, V* d, const size_t& parity) {
+            const auto [r0, r1] = rows(p);
+            const auto n = r1 - r0;
+            auto& scratch = _scratch[p];
+            const auto coupling = _coupling[parity];
+            const auto ends = _ends[parity];
+
+            //unknowns of partition q are its first and last values, every partition block is eliminated
+            //by the previous one and the resulting pivot blocks are lower triangular with unit second diagonal entry
+            for (size_t k = 0; k < _nb; ++k) {
+                scratch(0, 0, k) = F(1);
+                scratch(0, 1, k) = F(0);
+                scratch(0, 2, k) = F(ends(0, 0, k));
+                scratch(0, 3, k) = F(ends(0, 1, k));
+            }
+
+            for (size_t q = 1; q < _np; ++q)
+                for (size_t k = 0; k < _nb; ++k) {
+                    const auto s = scratch(q - 1, 1, k) * coupling(q - 1, 2, k) + coupling(q - 1, 3, k);
+                    const auto t = scratch(q - 1, 1, k) * scratch(q - 1, 2, k) + scratch(q - 1, 3, k);
+                    const auto r = F(1) / (F(1) - coupling(q, 0, k) * s);
+                    scratch(q, 0, k) = r;
+                    scratch(q, 1, k) = coupling(q, 1, k) * s * r;
+                    scratch(q, 2, k) = F(ends(q, 0, k)) - coupling(q, 0, k) * t;
+                    scratch(q, 3, k) = F(ends(q, 1, k)) - coupling(q, 1, k) * t;
+                }
+
+            //back substitution goes down to the left neighbour only, it yields the first value of the right neighbour
+            //and the last value of the left neighbour
+            auto& values = _values[p];
+            values.fill(F(0));
+
+            const auto first = values[0].data(), right = values[1].data(), left = values[2].data();
+            for (size_t q = _np, qe = p > 0 ? p - 1 : 0; q-- > qe;)
+                for (size_t k = 0; k < _nb; ++k) {
+                    const auto a = scratch(q, 2, k) - coupling(q, 2, k) * first[k];
+                    const auto b = scratch(q, 3, k) - coupling(q, 3, k) * first[k];
+                    if (q == p + 1)
+                        right[k] = first[k] = scratch(q, 0, k) * a;
+                    else
+                        first[k] = scratch(q, 0, k) * a;
+                    if (q + 1 == p)
+                        left[k] = scratch(q, 1, k) * a + b;
+                }
+
+            const auto& alpha = _alpha[p];
+            const auto& beta = _beta[p];
+            for (size_t k = 0; k < _nb; ++k) {
+                left[k] *= alpha[k];
+                right[k] *= beta[k];
+            }
+
+            const auto& v = _v[p];
+            const auto& w = _w[p];
+            for (size_t y = 0; y < n; ++y) {
+                const auto vy = v[y].data(), wy = w[y].data();
+                const auto dy = d + y * _nb;
+                for (size_t k = 0; k < _nb; ++k)
+                    dy[k] -= V(left[k] * vy[k] + right[k] * wy[k]);
+            }
+        }
+
+    private:
+
+        const size_t _ny, _nb, _np;
+        types::vector1d_t<batched_thomas_solver<V, F>> _local;
+        types::vector1d_t<tensor<F, 2>> _v, _w;
+        types::vector2d_t<F> _alpha, _beta;
+        tensor<F, 4> _coupling;
+        tensor<V, 4> _ends;
+        types::vector1d_t<tensor<F, 3>> _scratch;
+        types::vector1d_t<tensor<F, 2>> _values;
+
+    };
+
+}// namespace ample::utils
@@ -28,6 +28,9 @@ namespace ample::types {
     using real_t = double;
     using complex_t = std::complex<real_t>;
 
+    using single_real_t = float;
+    using single_complex_t = std::complex<single_real_t>;
+
     template<typename T>
     using vector1d_t = std::vector<T>;
 